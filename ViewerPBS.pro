@@ -1,6 +1,6 @@
 # Author: Marc Comino 2020. Modified by Imanol Munoz-Pandiella 2022.
 
-QT       += opengl
+QT       += opengl concurrent
 
 TARGET = ViewerPBS
 TEMPLATE = app
@@ -22,19 +22,58 @@ INCLUDEPATH += /opt/homebrew/Cellar/glm/0.9.9.8/include
 
 SOURCES += \
     triangle_mesh.cc \
+    ambient_occlusion.cc \
+    bvh.cc \
     mesh_io.cc \
+    mesh_cache.cc \
+    mesh_loader.cc \
+    mesh_adjacency.cc \
+    mesh_optimizer.cc \
+    mesh_simplifier.cc \
+    meshlet.cc \
+    mesh_cleanup.cc \
+    vertex_normals.cc \
+    vertex_attributes.cc \
+    vertex_format.cc \
+    vertex_stream.cc \
+    index_buffer.cc \
+    load_profile.cc \
     main.cc \
     main_window.cc \
     glwidget.cc \
     camera.cc \
+    mapped_file.cc \
+    obj_parser.cc \
+    ply_schema.cc \
     tiny_obj_loader.cc
 
 HEADERS  += \
     triangle_mesh.h \
+    ambient_occlusion.h \
+    bvh.h \
     mesh_io.h \
+    mesh_cache.h \
+    mesh_loader.h \
+    mesh_adjacency.h \
+    mesh_optimizer.h \
+    mesh_simplifier.h \
+    meshlet.h \
+    mesh_cleanup.h \
+    vertex_normals.h \
+    vertex_attributes.h \
+    vertex_format.h \
+    vertex_stream.h \
+    index_buffer.h \
+    load_profile.h \
     main_window.h \
     glwidget.h \
     camera.h \
+    mapped_file.h \
+    obj_parser.h \
+    parallel.h \
+    radix_sort.h \
+    ply_schema.h \
+    text_parsing.h \
     tiny_obj_loader.h
 
 FORMS    += \
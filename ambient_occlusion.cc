@@ -0,0 +1,119 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <ambient_occlusion.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kOcclusionBias Offset of the ray origins along the normal, relative
+ * to the longest edge of the bounding box, so that the rays do not hit the
+ * faces around their vertex.
+ */
+const float kOcclusionBias = 1e-4f;
+
+const float kPi = 3.14159265358979f;
+
+/**
+ * @brief kUnitScale Maps 32-bit integers to [0, 1).
+ */
+const float kUnitScale = 2.3283064365386963e-10f;
+
+/**
+ * @brief RadicalInverse Van der Corput sequence in base 2.
+ */
+float RadicalInverse(uint32_t bits) {
+  bits = (bits << 16) | (bits >> 16);
+  bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+  bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+  bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+  bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+  return bits * kUnitScale;
+}
+
+/**
+ * @brief Hash Integer hash with good avalanche, to decorrelate the vertices.
+ */
+uint32_t Hash(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+float Fraction(float value) { return value - std::floor(value); }
+
+}  // namespace
+
+void BakeAmbientOcclusion(TriangleMesh *mesh, const Bvh &bvh, size_t rays,
+                          float max_distance) {
+  const size_t kVertices = mesh->vertices_.size() / 3;
+  VertexStream *occlusion = mesh->SetStream(MakeVertexStream(
+      kOcclusionStream, ComponentType::kUnorm16, 1, kVertices));
+  uint16_t *values = reinterpret_cast<uint16_t *>(occlusion->data.data());
+  std::fill(values, values + kVertices, 0xFFFF);
+  if (rays == 0 || bvh.empty() || mesh->normals_.size() != 3 * kVertices)
+    return;
+
+  const glm::vec3 kExtent = mesh->max_ - mesh->min_;
+  const float kScale = std::max(kExtent[0], std::max(kExtent[1], kExtent[2]));
+  const float kBias = kOcclusionBias * kScale;
+  const float kDistance = max_distance * kScale;
+
+  ParallelFor(kVertices, 64, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      glm::vec3 normal(mesh->normals_[3 * v], mesh->normals_[3 * v + 1],
+                       mesh->normals_[3 * v + 2]);
+      const float kLength = glm::length(normal);
+      if (!(kLength > 0.0f)) continue;
+      normal /= kLength;
+
+      // Orthonormal basis around the normal (Duff et al. 2017).
+      const float kSign = normal[2] >= 0.0f ? 1.0f : -1.0f;
+      const float kA = -1.0f / (kSign + normal[2]);
+      const float kB = normal[0] * normal[1] * kA;
+      const glm::vec3 kTangent(1.0f + kSign * normal[0] * normal[0] * kA,
+                               kSign * kB, -kSign * normal[0]);
+      const glm::vec3 kBitangent(kB, kSign + normal[1] * normal[1] * kA,
+                                 -normal[1]);
+
+      const glm::vec3 kOrigin =
+          glm::vec3(mesh->vertices_[3 * v], mesh->vertices_[3 * v + 1],
+                    mesh->vertices_[3 * v + 2]) +
+          kBias * normal;
+      const uint32_t kSeed = Hash(static_cast<uint32_t>(v));
+      const float kRotation0 = Hash(kSeed) * kUnitScale;
+      const float kRotation1 = Hash(kSeed ^ 0x9e3779b9u) * kUnitScale;
+
+      size_t escaped = 0;
+      for (size_t i = 0; i < rays; ++i) {
+        // Malley's method: uniform points on the disk projected up to the
+        // hemisphere are distributed by the cosine.
+        const float kU0 = Fraction((i + 0.5f) / rays + kRotation0);
+        const float kU1 =
+            Fraction(RadicalInverse(static_cast<uint32_t>(i)) + kRotation1);
+        const float kRadius = std::sqrt(kU0);
+        const float kPhi = 2.0f * kPi * kU1;
+        const glm::vec3 kDirection =
+            kRadius * std::cos(kPhi) * kTangent +
+            kRadius * std::sin(kPhi) * kBitangent +
+            std::sqrt(std::max(0.0f, 1.0f - kU0)) * normal;
+        if (!bvh.AnyHit(kOrigin, kDirection, kDistance)) ++escaped;
+      }
+      values[v] = static_cast<uint16_t>((escaped * 0xFFFF + rays / 2) / rays);
+    }
+  });
+}
+
+}  // namespace data_representation
@@ -0,0 +1,49 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef AMBIENT_OCCLUSION_H_
+#define AMBIENT_OCCLUSION_H_
+
+#include <bvh.h>
+#include <triangle_mesh.h>
+
+#include <cstddef>
+
+namespace data_representation {
+
+/**
+ * @brief kOcclusionRays Default number of rays cast from every vertex.
+ */
+const size_t kOcclusionRays = 64;
+
+/**
+ * @brief kOcclusionDistance Default length of the rays, relative to the
+ * longest edge of the bounding box. Farther geometry does not occlude.
+ */
+const float kOcclusionDistance = 0.5f;
+
+/**
+ * @brief kOcclusionStream Name of the vertex stream of the baked occlusion,
+ * one unsigned normalized 16-bit value per vertex, from 0 when fully
+ * occluded to 1 when nothing is in the way.
+ */
+const char kOcclusionStream[] = "occlusion";
+
+/**
+ * @brief BakeAmbientOcclusion Computes the kOcclusionStream stream of the
+ * mesh by casting cosine-weighted rays over the hemisphere of the normal of
+ * every vertex, in parallel. The fraction of rays that escape is the ambient
+ * occlusion, with the cosine already accounted for by the distribution. The
+ * directions are a Hammersley set with a random rotation per vertex, so
+ * neighbouring vertices do not share their error pattern.
+ * @param mesh The mesh, with normals and bounding box.
+ * @param bvh The hierarchy of the mesh.
+ * @param rays The number of rays per vertex.
+ * @param max_distance The length of the rays, see kOcclusionDistance.
+ */
+void BakeAmbientOcclusion(TriangleMesh *mesh, const Bvh &bvh,
+                          size_t rays = kOcclusionRays,
+                          float max_distance = kOcclusionDistance);
+
+}  // namespace data_representation
+
+#endif  // AMBIENT_OCCLUSION_H_
@@ -0,0 +1,528 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <bvh.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kBins Number of candidate splits per axis, plus one.
+ */
+const int kBins = 16;
+
+/**
+ * @brief kTraversalCost Cost of visiting an interior node relative to the
+ * intersection of a triangle.
+ */
+const float kTraversalCost = 1.0f;
+
+/**
+ * @brief kParallelGrain Smallest number of triangles binned by a thread. The
+ * children of nodes with at least twice as many are built as separate tasks.
+ */
+const size_t kParallelGrain = 1 << 15;
+
+/**
+ * @brief kMaxSahDepth Depth from which nodes are split in half instead, which
+ * bounds the depth of the hierarchy for degenerate inputs.
+ */
+const size_t kMaxSahDepth = 64;
+
+/**
+ * @brief kStackSize Traversal stack size, enough for kMaxSahDepth plus the
+ * halving of 2^32 triangles.
+ */
+const size_t kStackSize = kMaxSahDepth + 32;
+
+struct Bounds {
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+  void Extend(const glm::vec3 &p) {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+
+  void Extend(const Bounds &b) {
+    min = glm::min(min, b.min);
+    max = glm::max(max, b.max);
+  }
+
+  glm::vec3 Center() const { return (min + max) * 0.5f; }
+
+  float Area() const {
+    const glm::vec3 kSize = max - min;
+    if (kSize[0] < 0.0f) return 0.0f;
+    return 2.0f * (kSize[0] * kSize[1] + kSize[1] * kSize[2] +
+                   kSize[2] * kSize[0]);
+  }
+};
+
+/**
+ * @brief The Primitive struct Bounds of a triangle, moved along with its
+ * index while the nodes are partitioned so that every pass reads memory in
+ * order.
+ */
+struct Primitive {
+  Bounds bounds;
+  unsigned int triangle;
+};
+
+struct Bin {
+  Bounds bounds;
+  size_t count = 0;
+
+  void Extend(const Bin &b) {
+    bounds.Extend(b.bounds);
+    count += b.count;
+  }
+};
+
+/**
+ * @brief The NodeBounds struct Bounds of the triangles of a node and of their
+ * centroids.
+ */
+struct NodeBounds {
+  Bounds bounds;
+  Bounds centroids;
+};
+
+struct Bins {
+  Bin axes[3][kBins];
+};
+
+/**
+ * @brief BinCount Number of bins of a node. Small nodes, which are most of
+ * them, use one bin per triangle.
+ */
+int BinCount(size_t count) {
+  return static_cast<int>(std::min<size_t>(kBins, count));
+}
+
+/**
+ * @brief The Split struct Partition of a node into the triangles whose
+ * centroids fall in the bins up to and including bin, and the rest.
+ */
+struct Split {
+  int axis;
+  int bin;
+  float cost;
+};
+
+glm::vec3 Position(const TriangleMesh &mesh, int index) {
+  return glm::vec3(mesh.vertices_[3 * index], mesh.vertices_[3 * index + 1],
+                   mesh.vertices_[3 * index + 2]);
+}
+
+class Builder {
+ public:
+  explicit Builder(const TriangleMesh &mesh)
+      : primitives_(mesh.faces_.size() / 3) {
+    ParallelFor(primitives_.size(), kParallelGrain,
+                [&](size_t begin, size_t end) {
+      for (size_t t = begin; t < end; ++t) {
+        for (int k = 0; k < 3; ++k)
+          primitives_[t].bounds.Extend(Position(mesh, mesh.faces_[3 * t + k]));
+        primitives_[t].triangle = static_cast<unsigned int>(t);
+      }
+    });
+  }
+
+  /**
+   * @brief Build Builds the hierarchy into nodes and writes the triangles in
+   * leaf order.
+   */
+  void Build(std::vector<BvhNode> *nodes,
+             std::vector<unsigned int> *triangles) {
+    const size_t kThreads = NumThreads();
+    const size_t kChunks = Chunks(primitives_.size(), kThreads);
+    std::vector<NodeBounds> chunks(kChunks);
+    ParallelForChunks(primitives_.size(), kChunks,
+                      [&](size_t c, size_t begin, size_t end) {
+      chunks[c] = Measure(begin, end - begin);
+    });
+    NodeBounds root;
+    for (const NodeBounds &chunk : chunks) {
+      root.bounds.Extend(chunk.bounds);
+      root.centroids.Extend(chunk.centroids);
+    }
+
+    BuildNode(0, primitives_.size(), root, 0, kThreads, nodes);
+
+    triangles->resize(primitives_.size());
+    ParallelFor(primitives_.size(), kParallelGrain,
+                [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        (*triangles)[i] = primitives_[i].triangle;
+    });
+  }
+
+ private:
+  /**
+   * @brief BuildNode Appends the subtree of primitives_[first, first + count)
+   * to nodes in depth-first order, with offsets relative to nodes[0].
+   * @param bounds The bounds of the triangles and of their centroids.
+   * @param threads The threads available to the subtree. It is passed down
+   * the recursion because querying it is slow.
+   */
+  void BuildNode(size_t first, size_t count, const NodeBounds &bounds,
+                 size_t depth,
+                 size_t threads, std::vector<BvhNode> *nodes) {
+    const size_t kNode = nodes->size();
+    nodes->push_back(BvhNode());
+    (*nodes)[kNode].min = bounds.bounds.min;
+    (*nodes)[kNode].max = bounds.bounds.max;
+
+    Split split;
+    const bool kFound =
+        depth < kMaxSahDepth && FindSplit(first, count, bounds, threads,
+                                          &split);
+    if (count <= kMaxLeafTriangles &&
+        (!kFound || split.cost >= static_cast<float>(count))) {
+      (*nodes)[kNode].offset = static_cast<unsigned int>(first);
+      (*nodes)[kNode].count = static_cast<unsigned int>(count);
+      return;
+    }
+
+    NodeBounds left, right;
+    size_t middle;
+    if (kFound) {
+      middle = Partition(first, count, bounds.centroids, split, &left, &right);
+    } else {
+      // Without a split, as when all the centroids coincide, the node is
+      // split in half in its current order.
+      middle = first + count / 2;
+      left = Measure(first, middle - first);
+      right = Measure(middle, first + count - middle);
+    }
+
+    if (threads > 1 && count >= 2 * kParallelGrain) {
+      std::vector<BvhNode> right_nodes;
+      std::thread right_task([&]() {
+        BuildNode(middle, first + count - middle, right, depth + 1,
+                  threads - threads / 2, &right_nodes);
+      });
+      BuildNode(first, middle - first, left, depth + 1, threads / 2, nodes);
+      right_task.join();
+
+      const unsigned int kRight = static_cast<unsigned int>(nodes->size());
+      for (BvhNode node : right_nodes) {
+        if (node.count == 0) node.offset += kRight;
+        nodes->push_back(node);
+      }
+      (*nodes)[kNode].offset = kRight;
+    } else {
+      BuildNode(first, middle - first, left, depth + 1, threads, nodes);
+      (*nodes)[kNode].offset = static_cast<unsigned int>(nodes->size());
+      BuildNode(middle, first + count - middle, right, depth + 1, threads,
+                nodes);
+    }
+    (*nodes)[kNode].count = 0;
+  }
+
+  static size_t Chunks(size_t count, size_t threads) {
+    return std::max<size_t>(1, std::min(threads, count / kParallelGrain));
+  }
+
+  static float BinScale(const Bounds &centroids, int axis, int bins) {
+    return bins / (centroids.max[axis] - centroids.min[axis]);
+  }
+
+  static int BinIndex(const glm::vec3 &centroid, int axis, float min,
+                      float scale, int bins) {
+    return std::min(static_cast<int>((centroid[axis] - min) * scale),
+                    bins - 1);
+  }
+
+  NodeBounds Measure(size_t first, size_t count) const {
+    NodeBounds bounds;
+    for (size_t i = first; i < first + count; ++i) {
+      bounds.bounds.Extend(primitives_[i].bounds);
+      bounds.centroids.Extend(primitives_[i].bounds.Center());
+    }
+    return bounds;
+  }
+
+  /**
+   * @brief Partition Moves the triangles of the left side of a split before
+   * the others, measuring both sides on the way.
+   * @return The index of the first triangle of the right side.
+   */
+  size_t Partition(size_t first, size_t count, const Bounds &centroids,
+                   const Split &split, NodeBounds *left, NodeBounds *right) {
+    const int kBinCount = BinCount(count);
+    const float kMin = centroids.min[split.axis];
+    const float kScale = BinScale(centroids, split.axis, kBinCount);
+    size_t i = first, j = first + count;
+    while (i < j) {
+      const glm::vec3 kCentroid = primitives_[i].bounds.Center();
+      if (BinIndex(kCentroid, split.axis, kMin, kScale, kBinCount) <=
+          split.bin) {
+        left->bounds.Extend(primitives_[i].bounds);
+        left->centroids.Extend(kCentroid);
+        ++i;
+      } else {
+        right->bounds.Extend(primitives_[i].bounds);
+        right->centroids.Extend(kCentroid);
+        std::swap(primitives_[i], primitives_[--j]);
+      }
+    }
+    return i;
+  }
+
+  /**
+   * @brief FindSplit Bins the centroids of the triangles along the three axes
+   * in a single pass and finds the candidate split of least surface area
+   * heuristic cost.
+   * @return Whether the centroids span any axis.
+   */
+  bool FindSplit(size_t first, size_t count, const NodeBounds &bounds,
+                 size_t threads, Split *split) const {
+    const Bounds &kCentroids = bounds.centroids;
+    const int kBinCount = BinCount(count);
+    bool spans[3];
+    float scales[3];
+    bool any = false;
+    for (int axis = 0; axis < 3; ++axis) {
+      spans[axis] = kCentroids.max[axis] > kCentroids.min[axis];
+      scales[axis] =
+          spans[axis] ? BinScale(kCentroids, axis, kBinCount) : 0.0f;
+      any = any || spans[axis];
+    }
+    if (!any) return false;
+
+    // Only nodes binned by several threads allocate bins.
+    Bins merged;
+    const size_t kChunks = Chunks(count, threads);
+    std::vector<Bins> chunk_bins(kChunks - 1);
+    ParallelForChunks(count, kChunks, [&](size_t c, size_t begin,
+                                          size_t end) {
+      Bins &bins = c == 0 ? merged : chunk_bins[c - 1];
+      for (size_t i = first + begin; i < first + end; ++i) {
+        const Bounds &kBounds = primitives_[i].bounds;
+        const glm::vec3 kCentroid = kBounds.Center();
+        for (int axis = 0; axis < 3; ++axis) {
+          Bin &bin = bins.axes[axis][BinIndex(kCentroid, axis,
+                                              kCentroids.min[axis],
+                                              scales[axis], kBinCount)];
+          bin.bounds.Extend(kBounds);
+          ++bin.count;
+        }
+      }
+    });
+    for (const Bins &chunk : chunk_bins)
+      for (int axis = 0; axis < 3; ++axis)
+        for (int b = 0; b < kBinCount; ++b)
+          merged.axes[axis][b].Extend(chunk.axes[axis][b]);
+
+    bool found = false;
+    split->cost = std::numeric_limits<float>::max();
+    const float kArea = bounds.bounds.Area();
+    for (int axis = 0; axis < 3; ++axis) {
+      if (!spans[axis]) continue;
+      const Bin *bins = merged.axes[axis];
+
+      // Sweep from the right to get the cost of every right side, then from
+      // the left to add the cost of every left side.
+      float right_costs[kBins];
+      Bounds right;
+      size_t right_count = 0;
+      for (int b = kBinCount - 1; b > 0; --b) {
+        right.Extend(bins[b].bounds);
+        right_count += bins[b].count;
+        right_costs[b - 1] = right.Area() * right_count;
+      }
+      Bounds left;
+      size_t left_count = 0;
+      for (int b = 0; b < kBinCount - 1; ++b) {
+        left.Extend(bins[b].bounds);
+        left_count += bins[b].count;
+        if (left_count == 0 || left_count == count) continue;
+        const float kCost =
+            kTraversalCost +
+            (left.Area() * left_count + right_costs[b]) / kArea;
+        if (kCost < split->cost) {
+          split->axis = axis;
+          split->bin = b;
+          split->cost = kCost;
+        }
+        found = true;
+      }
+    }
+    return found;
+  }
+
+  std::vector<Primitive> primitives_;
+};
+
+/**
+ * @brief IntersectBox Slab test of a ray against the bounds of a node.
+ * @param t_near The distance at which the ray enters the bounds.
+ */
+bool IntersectBox(const BvhNode &node, const glm::vec3 &origin,
+                  const glm::vec3 &inverse_direction, float t_max,
+                  float *t_near) {
+  const glm::vec3 kT0 = (node.min - origin) * inverse_direction;
+  const glm::vec3 kT1 = (node.max - origin) * inverse_direction;
+  const glm::vec3 kNear = glm::min(kT0, kT1);
+  const glm::vec3 kFar = glm::max(kT0, kT1);
+  *t_near = std::max(std::max(kNear[0], kNear[1]), std::max(kNear[2], 0.0f));
+  const float kTFar =
+      std::min(std::min(kFar[0], kFar[1]), std::min(kFar[2], t_max));
+  return *t_near <= kTFar;
+}
+
+/**
+ * @brief IntersectTriangle Moller-Trumbore test of a ray against both sides
+ * of a triangle, only reporting hits in (0, t_max).
+ * @param corners The three corners of the triangle.
+ */
+bool IntersectTriangle(const glm::vec3 *corners, unsigned int triangle,
+                       const glm::vec3 &origin, const glm::vec3 &direction,
+                       float t_max, RayHit *hit) {
+  const glm::vec3 &kP0 = corners[0];
+  const glm::vec3 kE1 = corners[1] - kP0;
+  const glm::vec3 kE2 = corners[2] - kP0;
+  const glm::vec3 kP = glm::cross(direction, kE2);
+  const float kDet = glm::dot(kE1, kP);
+  if (kDet == 0.0f) return false;
+
+  const float kInverseDet = 1.0f / kDet;
+  const glm::vec3 kS = origin - kP0;
+  const float kU = glm::dot(kS, kP) * kInverseDet;
+  if (kU < 0.0f || kU > 1.0f) return false;
+  const glm::vec3 kQ = glm::cross(kS, kE1);
+  const float kV = glm::dot(direction, kQ) * kInverseDet;
+  if (kV < 0.0f || kU + kV > 1.0f) return false;
+  const float kT = glm::dot(kE2, kQ) * kInverseDet;
+  if (!(kT > 0.0f && kT < t_max)) return false;
+
+  *hit = RayHit{kT, triangle, kU, kV};
+  return true;
+}
+
+/**
+ * @brief Traverse Visits the leaves hit by a ray nearest first, calling
+ * visit(leaf, t_max) for each, which returns the new t_max. Stops when a leaf
+ * returns a negative value.
+ */
+template <typename F>
+void Traverse(const std::vector<BvhNode> &nodes, const glm::vec3 &origin,
+              const glm::vec3 &direction, float t_max, const F &visit) {
+  if (nodes.empty()) return;
+  const glm::vec3 kInverse(1.0f / direction[0], 1.0f / direction[1],
+                           1.0f / direction[2]);
+  std::pair<unsigned int, float> stack[kStackSize];
+  size_t size = 0;
+  float t_near;
+  if (!IntersectBox(nodes[0], origin, kInverse, t_max, &t_near)) return;
+  stack[size++] = std::make_pair(0u, t_near);
+
+  while (size > 0) {
+    const std::pair<unsigned int, float> kEntry = stack[--size];
+    if (kEntry.second > t_max) continue;
+    const BvhNode &kNode = nodes[kEntry.first];
+    if (kNode.count > 0) {
+      t_max = visit(kNode, t_max);
+      if (t_max < 0.0f) return;
+      continue;
+    }
+
+    // The nearest child is pushed last so that it is visited first.
+    unsigned int first = kEntry.first + 1, second = kNode.offset;
+    float t_first, t_second;
+    const bool kHitFirst =
+        IntersectBox(nodes[first], origin, kInverse, t_max, &t_first);
+    const bool kHitSecond =
+        IntersectBox(nodes[second], origin, kInverse, t_max, &t_second);
+    if (kHitFirst && kHitSecond && t_second < t_first) {
+      std::swap(first, second);
+      std::swap(t_first, t_second);
+    }
+    if (kHitSecond) stack[size++] = std::make_pair(second, t_second);
+    if (kHitFirst) stack[size++] = std::make_pair(first, t_first);
+  }
+}
+
+}  // namespace
+
+void Bvh::Build(const TriangleMesh &mesh) {
+  Clear();
+  const size_t kTriangles = mesh.faces_.size() / 3;
+  if (kTriangles == 0) return;
+
+  Builder builder(mesh);
+  // A leaf holds about two triangles on average.
+  nodes_.reserve(kTriangles);
+  builder.Build(&nodes_, &triangles_);
+
+  // The corners are copied in leaf order, so that the queries need neither
+  // the mesh nor its arrays and read the triangles of a leaf contiguously.
+  corners_.resize(3 * kTriangles);
+  ParallelFor(kTriangles, kParallelGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      for (size_t k = 0; k < 3; ++k)
+        corners_[3 * i + k] =
+            Position(mesh, mesh.faces_[3 * triangles_[i] + k]);
+    }
+  });
+}
+
+void Bvh::Clear() {
+  nodes_.clear();
+  nodes_.shrink_to_fit();
+  triangles_.clear();
+  triangles_.shrink_to_fit();
+  corners_.clear();
+  corners_.shrink_to_fit();
+}
+
+bool Bvh::ClosestHit(const glm::vec3 &origin, const glm::vec3 &direction,
+                     float t_max, RayHit *hit) const {
+  bool found = false;
+  Traverse(nodes_, origin, direction, t_max,
+           [&](const BvhNode &leaf, float t) {
+             for (unsigned int i = leaf.offset; i < leaf.offset + leaf.count;
+                  ++i) {
+               if (IntersectTriangle(&corners_[3 * i], triangles_[i], origin,
+                                     direction, t, hit)) {
+                 t = hit->t;
+                 found = true;
+               }
+             }
+             return t;
+           });
+  return found;
+}
+
+bool Bvh::AnyHit(const glm::vec3 &origin, const glm::vec3 &direction,
+                 float t_max) const {
+  bool found = false;
+  Traverse(nodes_, origin, direction, t_max,
+           [&](const BvhNode &leaf, float t) {
+             RayHit hit;
+             for (unsigned int i = leaf.offset; i < leaf.offset + leaf.count;
+                  ++i) {
+               if (IntersectTriangle(&corners_[3 * i], triangles_[i], origin,
+                                     direction, t, &hit)) {
+                 found = true;
+                 return -1.0f;
+               }
+             }
+             return t;
+           });
+  return found;
+}
+
+}  // namespace data_representation
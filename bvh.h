@@ -0,0 +1,143 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef BVH_H_
+#define BVH_H_
+
+#include <triangle_mesh.h>
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief kMaxLeafTriangles Largest number of triangles of a leaf.
+ */
+const size_t kMaxLeafTriangles = 8;
+
+/**
+ * @brief The BvhNode struct Node of a flattened bounding volume hierarchy,
+ * 32 bytes long so that two of them share a cache line. The nodes are stored
+ * in depth-first order, so the left child of an interior node is the next
+ * node.
+ */
+struct BvhNode {
+  glm::vec3 min;
+
+  /**
+   * @brief offset Index of the right child of an interior node, or of the
+   * first triangle of a leaf in Bvh::triangles().
+   */
+  unsigned int offset;
+
+  glm::vec3 max;
+
+  /**
+   * @brief count Number of triangles of a leaf, 0 for interior nodes.
+   */
+  unsigned int count;
+};
+
+/**
+ * @brief The RayHit struct Intersection of a ray with a triangle.
+ */
+struct RayHit {
+  /**
+   * @brief t Distance along the ray, in units of its direction.
+   */
+  float t;
+
+  /**
+   * @brief triangle Index of the triangle in faces_, divided by 3.
+   */
+  unsigned int triangle;
+
+  /**
+   * @brief u Barycentric coordinate of the second vertex of the triangle.
+   */
+  float u;
+
+  /**
+   * @brief v Barycentric coordinate of the third vertex of the triangle.
+   */
+  float v;
+};
+
+/**
+ * @brief The Bvh class Bounding volume hierarchy over the triangles of a
+ * mesh, for ray queries on the CPU. It keeps its own copy of the triangle
+ * positions, so it answers queries after the mesh arrays are released.
+ */
+class Bvh {
+ public:
+  /**
+   * @brief Build Builds the hierarchy top-down, splitting every node at the
+   * cheapest of the binned surface area heuristic candidates of its three
+   * axes (Wald 2007). The binning of large nodes is split among threads, and
+   * the two children of large nodes are built as separate tasks, each with
+   * half of the threads.
+   * @param mesh The mesh. Its triangle corners are copied in leaf order.
+   */
+  void Build(const TriangleMesh &mesh);
+
+  /**
+   * @brief Clear Releases the hierarchy.
+   */
+  void Clear();
+
+  /**
+   * @brief ClosestHit Finds the closest triangle hit by a ray, visiting the
+   * nearest child of every node first.
+   * @param origin The origin of the ray.
+   * @param direction The direction of the ray, not necessarily normalized.
+   * @param t_max The largest distance along the ray to consider.
+   * @param hit The closest hit, if any.
+   * @return Whether any triangle was hit.
+   */
+  bool ClosestHit(const glm::vec3 &origin, const glm::vec3 &direction,
+                  float t_max, RayHit *hit) const;
+
+  /**
+   * @brief AnyHit Finds whether a ray hits any triangle, stopping at the
+   * first one found.
+   * @param origin The origin of the ray.
+   * @param direction The direction of the ray, not necessarily normalized.
+   * @param t_max The largest distance along the ray to consider.
+   * @return Whether any triangle was hit.
+   */
+  bool AnyHit(const glm::vec3 &origin, const glm::vec3 &direction,
+              float t_max) const;
+
+  bool empty() const { return nodes_.empty(); }
+  const std::vector<BvhNode> &nodes() const { return nodes_; }
+
+  /**
+   * @brief triangles Triangle indices in leaf order.
+   */
+  const std::vector<unsigned int> &triangles() const { return triangles_; }
+
+  /**
+   * @brief corners The three corners of every triangle, in leaf order.
+   */
+  const std::vector<glm::vec3> &corners() const { return corners_; }
+
+  /**
+   * @brief bytes Memory used by the hierarchy.
+   */
+  size_t bytes() const {
+    return nodes_.size() * sizeof(BvhNode) +
+           triangles_.size() * sizeof(unsigned int) +
+           corners_.size() * sizeof(glm::vec3);
+  }
+
+ private:
+  std::vector<BvhNode> nodes_;
+  std::vector<unsigned int> triangles_;
+  std::vector<glm::vec3> corners_;
+};
+
+}  // namespace data_representation
+
+#endif  // BVH_H_
@@ -2,15 +2,28 @@
 
 #include <glwidget.h>
 
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 #include <sstream>
 
+#include "./ambient_occlusion.h"
+#include "./bvh.h"
 #include "./mesh_io.h"
+#include "./mesh_loader.h"
+#include "./meshlet.h"
+#include "./index_buffer.h"
 #include "./triangle_mesh.h"
+#include "./vertex_attributes.h"
+#include "./vertex_format.h"
 
+#include <glm/geometric.hpp>
 #include <glm/mat4x4.hpp>
 
 namespace {
@@ -27,9 +40,65 @@ const std::vector<std::vector<std::string>> kShaderFiles = {
                 {"../shaders/ibl-pbs.vert",      "../shaders/ibl-pbs.frag"},
                 {"../shaders/sky.vert",          "../shaders/sky.frag"}};//sky needs to be the last one
 
+/**
+ * @brief kMaxLodPixelError Screen-space error, in pixels, allowed when
+ * selecting the level of detail.
+ */
+const float kMaxLodPixelError = 1.0f;
+
 const int kVertexAttributeIdx = 0;
 const int kNormalAttributeIdx = 1;
 const int kTexCoordAttributeIdx = 2;
+const int kOcclusionAttributeIdx = 3;
+
+/**
+ * @brief kFirstStreamAttributeIdx Location of the first vertex stream, the
+ * next ones follow in order up to kMaxAttributeIdx.
+ */
+const int kFirstStreamAttributeIdx = 4;
+const int kMaxAttributeIdx = 15;
+
+/**
+ * @brief kShaderStreams Vertex streams some shader reads, which are packed
+ * into the vertex buffer. The other streams stay on the CPU.
+ */
+const std::vector<std::string> kShaderStreams = {data_representation::kOcclusionStream};
+
+/**
+ * @brief AttributeIdx Location of a packed attribute of the given name, or -1
+ * for a stream, which take the locations from kFirstStreamAttributeIdx.
+ */
+int AttributeIdx(const std::string &name) {
+  if (name == "position") return kVertexAttributeIdx;
+  if (name == "normal") return kNormalAttributeIdx;
+  if (name == "tex_coord") return kTexCoordAttributeIdx;
+  if (name == data_representation::kOcclusionStream) return kOcclusionAttributeIdx;
+  return -1;
+}
+
+GLenum AttributeType(data_representation::ComponentType type) {
+  switch (type) {
+    case data_representation::ComponentType::kFloat32: return GL_FLOAT;
+    case data_representation::ComponentType::kFloat16: return GL_HALF_FLOAT;
+    case data_representation::ComponentType::kUnorm8: return GL_UNSIGNED_BYTE;
+    case data_representation::ComponentType::kSnorm8: return GL_BYTE;
+    case data_representation::ComponentType::kUnorm16: return GL_UNSIGNED_SHORT;
+    case data_representation::ComponentType::kSnorm16: return GL_SHORT;
+    case data_representation::ComponentType::kSnorm2101010: return GL_INT_2_10_10_10_REV;
+  }
+  return GL_FLOAT;
+}
+
+/**
+ * @brief ShaderAttributes Vertex attributes derived on load that the shader
+ * reads. Only the PBS shaders sample textures.
+ */
+uint32_t ShaderAttributes(int shader) {
+  uint32_t attributes = data_representation::kNormalAttribute;
+  if (shader == 3 || shader == 4)
+    attributes |= data_representation::kTexCoordAttribute;
+  return attributes;
+}
 
 
 bool ReadFile(const std::string filename, std::string *shader_source) {
@@ -48,17 +117,36 @@ bool ReadFile(const std::string filename, std::string *shader_source) {
   return true;
 }
 
+void UploadImage(const QImage &image, GLuint cube_map_pos) {
+  glTexImage2D(cube_map_pos, 0, GL_RGBA, image.width(), image.height(), 0,
+               GL_BGRA, GL_UNSIGNED_BYTE, image.bits());
+}
+
 bool LoadImage(const std::string &path, GLuint cube_map_pos) {
   QImage image;
   bool res = image.load(path.c_str());
   if (res) {
     QImage gl_image = image.mirrored();
-    glTexImage2D(cube_map_pos, 0, GL_RGBA, image.width(), image.height(), 0,
-                 GL_BGRA, GL_UNSIGNED_BYTE, image.bits());
+    UploadImage(image, cube_map_pos);
   }
   return res;
 }
 
+/**
+ * @brief The LoadedModel struct Result of a background load: the mesh, its
+ * packed vertex and index buffers, the decoded diffuse maps of its materials
+ * keyed by path, and the stage timings.
+ */
+struct LoadedModel {
+  data_representation::TriangleMesh mesh;
+  data_representation::Bvh bvh;
+  data_representation::SourceKey source_key;
+  data_representation::PackedVertices vertices;
+  data_representation::PackedIndices indices;
+  std::map<std::string, QImage> images;
+  data_representation::LoadProfile profile;
+};
+
 bool LoadCubeMap(const QString &dir) {
   std::string path = dir.toUtf8().constData();
   bool res = LoadImage(path + "/right.png", GL_TEXTURE_CUBE_MAP_POSITIVE_X);
@@ -94,6 +182,7 @@ bool LoadProgram(const std::string &vertex, const std::string &fragment,
     program->bindAttributeLocation("vertex", kVertexAttributeIdx);
     program->bindAttributeLocation("normal", kNormalAttributeIdx);
     program->bindAttributeLocation("texCoord", kTexCoordAttributeIdx);
+    program->bindAttributeLocation("occlusion", kOcclusionAttributeIdx);
     program->link();
   }
 
@@ -112,37 +201,336 @@ GLWidget::GLWidget(QWidget *parent)
     currentTexture_(0),
       skyVisible_(true),
       metalness_(0),
-      roughness_(0)
+      roughness_(0),
+      gbuffer_query_pending_(false),
+      gbuffer_query_lod_(0),
+      fragment_query_pending_(false),
+      count_fragments_(false)
         {
   setFocusPolicy(Qt::StrongFocus);
+
+  load_options_.optimize_vertex_cache = true;
+  load_options_.optimize_overdraw = true;
+  vertex_format_ = data_representation::kCompactVertexFormat;
+  split_indices_ = true;
+  load_options_.lod_count = 3;
+  load_options_.build_meshlets = true;
+  forced_lod_ = -1;
+  cull_frustum_ = true;
+  cull_backfaces_ = true;
+  release_mesh_arrays_ = true;
+  released_attributes_ = 0;
+  gpu_vertex_bytes_ = 0;
+  gpu_index_bytes_ = 0;
+  gpu_texture_bytes_ = 0;
+
+  // Loads are already parallel internally, so they run one at a time.
+  load_pool_.setMaxThreadCount(1);
+  load_generation_ = 0;
 }
 
 GLWidget::~GLWidget() {
+  load_pool_.waitForDone();
   if (initialized_) {
     glDeleteTextures(1, &specular_map_);
     glDeleteTextures(1, &diffuse_map_);
+    glDeleteQueries(1, &gbuffer_query_);
+    glDeleteQueries(1, &fragment_query_);
   }
 }
 
 bool GLWidget::LoadModel(const QString &filename) {
+  typedef std::shared_ptr<LoadedModel> ModelPointer;
+
   std::string file = filename.toUtf8().constData();
   size_t pos = file.find_last_of(".");
   std::string type = file.substr(pos + 1);
+  if (type.compare("ply") != 0 && type.compare("obj") != 0) return false;
+
+  const int generation = ++load_generation_;
+  data_representation::LoadOptions options = load_options_;
+  options.attributes = ShaderAttributes(currentShader_);
+  options.progress = [this, generation](const std::string &stage,
+                                        float fraction) {
+    if (generation == load_generation_)
+      emit LoadProgress(QString::fromStdString(stage),
+                        static_cast<int>(100 * fraction));
+  };
+
+  // Parsing runs on the pool; the GL upload happens here once it finishes.
+  auto *watcher = new QFutureWatcher<ModelPointer>(this);
+  connect(watcher, &QFutureWatcher<ModelPointer>::finished, this,
+          [this, watcher, generation, filename, file, options]() {
+    ModelPointer model = watcher->result();
+    watcher->deleteLater();
+    if (generation != load_generation_) return;
+
+    if (model != nullptr) {
+      uint64_t bytes =
+          model->vertices.data.size() + model->indices.data.size();
+      for (const auto &image : model->images)
+        bytes += image.second.bytesPerLine() * image.second.height();
+
+      {
+        data_representation::ScopedStage stage(&model->profile, "gl upload",
+                                               bytes);
+        makeCurrent();
+        bvh_ = std::move(model->bvh);
+        mesh_file_ = file;
+        mesh_options_ = options;
+        mesh_options_.progress = nullptr;
+        mesh_key_ = model->source_key;
+        UploadMesh(std::make_unique<data_representation::TriangleMesh>(
+                       std::move(model->mesh)),
+                   model->vertices, model->indices, model->images);
+        // Include the transfer itself rather than just queuing it.
+        glFinish();
+        doneCurrent();
+      }
+      // The shader may have changed while loading.
+      CompleteVertexAttributes();
+      ReleaseMeshArrays();
+      update();
+
+      model->profile.SetMetric("cpu_resident_bytes",
+                               mesh_->ResidentBytes() + bvh_.bytes());
+      model->profile.SetMetric("gpu_resident_bytes", gpu_vertex_bytes_ +
+                                                         gpu_index_bytes_ +
+                                                         gpu_texture_bytes_);
+
+      emit SetLoadProfile(
+          QString::fromStdString(model->profile.ToJson(file)));
+    }
+    emit ModelLoaded(model != nullptr, filename);
+  });
+
+  const data_representation::VertexFormat format = vertex_format_;
+  const bool split_indices = split_indices_;
+  watcher->setFuture(QtConcurrent::run(&load_pool_, [file, options, format,
+                                                     split_indices]() {
+    ModelPointer model = std::make_shared<LoadedModel>();
+    data_representation::LoadOptions model_options = options;
+    model_options.profile = &model->profile;
+    model_options.bvh = &model->bvh;
+    model_options.source_key = &model->source_key;
+    if (!data_representation::LoadMesh(file, model_options, &model->mesh))
+      return ModelPointer();
+
+    {
+      data_representation::ScopedStage stage(&model->profile, "index packing");
+      data_representation::PackIndices(model->mesh, split_indices,
+                                       &model->indices);
+      stage.set_bytes(model->indices.data.size());
+    }
+    {
+      data_representation::ScopedStage stage(&model->profile, "vertex packing");
+      data_representation::PackVertices(model->mesh, format, kShaderStreams,
+                                        model->indices.vertex_remap,
+                                        &model->vertices);
+      stage.set_bytes(model->vertices.data.size());
+    }
 
-  std::unique_ptr<data_representation::TriangleMesh> mesh =
-      std::make_unique<data_representation::TriangleMesh>();
+    data_representation::ScopedStage stage(&model->profile, "texture decode");
+    uint64_t bytes = 0;
+    for (const auto &material : model->mesh.materials_) {
+      const std::string &path = material.diffuse_map;
+      if (path.empty() || model->images.count(path) > 0) continue;
+      QImage image;
+      if (!image.load(path.c_str()))
+        std::cerr << "Could not load " << path << std::endl;
+      bytes += image.bytesPerLine() * image.height();
+      model->images[path] = image;
+    }
+    stage.set_bytes(bytes);
+    return model;
+  }));
+  return true;
+}
 
-  bool res = false;
-  if (type.compare("ply") == 0) {
-    res = data_representation::ReadFromPly(file, mesh.get());
-  } else if (type.compare("obj") == 0) {
-    res = data_representation::ReadFromObj(file, mesh.get());
-  } else if(type.compare("null") == 0) {
-    res = data_representation::CreateSphere(mesh.get());
-  }
+void GLWidget::UploadVertices(
+    const data_representation::PackedVertices &vertices) {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_v);
+    glBufferData(GL_ARRAY_BUFFER, vertices.data.size(), vertices.data.data(), GL_STATIC_DRAW);
+    gpu_vertex_bytes_ = vertices.data.size();
+
+    // The previous mesh may have had more attributes. Without baked occlusion
+    // the shaders read the constant 1.
+    for (int idx = kOcclusionAttributeIdx; idx <= kMaxAttributeIdx; ++idx)
+        glDisableVertexAttribArray(idx);
+    glVertexAttrib1f(kOcclusionAttributeIdx, 1.0f);
+
+    const GLsizei stride = static_cast<GLsizei>(vertices.stride);
+    int stream_idx = kFirstStreamAttributeIdx;
+    for (const auto &attribute : vertices.attributes) {
+        int idx = AttributeIdx(attribute.name);
+        if (idx < 0 && stream_idx > kMaxAttributeIdx) {
+            std::cerr << "No attribute location left for the vertex stream " << attribute.name << std::endl;
+            continue;
+        }
+        if (idx < 0) idx = stream_idx++;
+        const GLboolean normalized = data_representation::IsNormalized(attribute.type) ? GL_TRUE : GL_FALSE;
+        glVertexAttribPointer(idx, static_cast<GLint>(attribute.components), AttributeType(attribute.type), normalized,
+                              stride, reinterpret_cast<const GLvoid *>(attribute.offset));
+        glEnableVertexAttribArray(idx);
+    }
 
-  if (res) {
-    mesh_.reset(mesh.release());
+    glBindVertexArray(0);
+
+    uploaded_format_ = vertices.format;
+    position_offset_ = vertices.position_offset;
+    position_scale_ = vertices.position_scale;
+    std::cout << "Vertex buffer: " << vertices.vertex_count() << " vertices, "
+              << vertices.stride << " bytes each" << std::endl;
+}
+
+void GLWidget::SetVertexDecodeUniforms(QOpenGLShaderProgram *program) {
+    program->setUniformValue("position_offset", position_offset_[0],
+                             position_offset_[1], position_offset_[2]);
+    program->setUniformValue("position_scale", position_scale_[0],
+                             position_scale_[1], position_scale_[2]);
+    program->setUniformValue(
+        "octahedral_normals",
+        static_cast<GLint>(uploaded_format_.normals ==
+                           data_representation::NormalFormat::kOctahedral));
+}
+
+void GLWidget::UploadIndices(const data_representation::PackedIndices &indices) {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBO_i);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.data.size(), indices.data.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    gpu_index_bytes_ = indices.data.size();
+
+    index_lods_ = indices.lods;
+    gbuffer_query_lod_ = 0;
+    for (size_t i = 0; i < index_lods_.size(); ++i)
+        std::cout << "Index buffer LOD " << i << ": "
+                  << index_lods_[i].index_count() / 3 << " triangles, "
+                  << index_lods_[i].index_size * 8 << "-bit, "
+                  << index_lods_[i].chunks.size() << " draws" << std::endl;
+}
+
+void GLWidget::RepackMesh() {
+    if (mesh_ == nullptr || !EnsureMeshArrays()) return;
+
+    data_representation::PackedIndices indices;
+    data_representation::PackIndices(*mesh_, split_indices_, &indices);
+    data_representation::PackedVertices vertices;
+    data_representation::PackVertices(*mesh_, vertex_format_, kShaderStreams,
+                                      indices.vertex_remap, &vertices);
+    makeCurrent();
+    UploadVertices(vertices);
+    UploadIndices(indices);
+    doneCurrent();
+    ReleaseMeshArrays();
+    update();
+}
+
+void GLWidget::CompleteVertexAttributes() {
+    if (mesh_ == nullptr) return;
+
+    const uint32_t wanted = ShaderAttributes(currentShader_);
+    const uint32_t missing = mesh_->released()
+        ? wanted & ~released_attributes_
+        : data_representation::MissingVertexAttributes(*mesh_, wanted);
+    if (missing == 0) return;
+    // Reloading computes what the cache lacks.
+    if (!EnsureMeshArrays()) return;
+    const uint32_t still_missing = data_representation::MissingVertexAttributes(*mesh_, wanted);
+    if (still_missing != 0) data_representation::ComputeVertexAttributes(still_missing, mesh_.get());
+    RepackMesh();
+}
+
+bool GLWidget::EnsureMeshArrays() {
+    if (!mesh_->released()) return true;
+
+    data_representation::LoadOptions options = mesh_options_;
+    options.attributes |= released_attributes_ | ShaderAttributes(currentShader_);
+    if (!data_representation::ReloadMeshArrays(mesh_file_, mesh_key_, options, mesh_.get()))
+        return false;
+    ReportResidency();
+    return true;
+}
+
+void GLWidget::ReleaseMeshArrays() {
+    if (release_mesh_arrays_ && !mesh_file_.empty() && !mesh_->released()) {
+        released_attributes_ = data_representation::kAllVertexAttributes &
+            ~data_representation::MissingVertexAttributes(*mesh_, data_representation::kAllVertexAttributes);
+        mesh_->ReleaseArrays();
+    }
+    ReportResidency();
+}
+
+void GLWidget::ReportResidency() {
+    const uint64_t cpu = mesh_->ResidentBytes() + bvh_.bytes();
+    const uint64_t gpu = gpu_vertex_bytes_ + gpu_index_bytes_ + gpu_texture_bytes_;
+    std::cout << "Resident mesh memory: " << cpu << " bytes on the CPU, "
+              << gpu << " bytes on the GPU" << std::endl;
+    emit SetResidency(QString("CPU: %1 MB, GPU: %2 MB%3")
+                          .arg(cpu / 1048576.0, 0, 'f', 1)
+                          .arg(gpu / 1048576.0, 0, 'f', 1)
+                          .arg(mesh_->released() ? " (arrays released)" : ""));
+}
+
+void GLWidget::SetReleaseMeshArrays(bool release) {
+    release_mesh_arrays_ = release;
+    if (mesh_ == nullptr) return;
+    if (release)
+        ReleaseMeshArrays();
+    else if (EnsureMeshArrays())
+        ReportResidency();
+}
+
+void GLWidget::SetVertexFormat(const data_representation::VertexFormat &format) {
+    vertex_format_ = format;
+    RepackMesh();
+}
+
+void GLWidget::SetSplitIndices(bool split) {
+    split_indices_ = split;
+    RepackMesh();
+}
+
+void GLWidget::SetForcedLod(int lod) {
+    forced_lod_ = lod;
+    update();
+}
+
+void GLWidget::SetCleanMesh(bool clean) {
+    load_options_.clean_mesh = clean;
+}
+
+void GLWidget::SetSpatialSort(bool sort) {
+    load_options_.spatial_sort = sort;
+}
+
+void GLWidget::SetBakeOcclusion(bool bake) {
+    load_options_.occlusion_rays = bake ? data_representation::kOcclusionRays : 0;
+}
+
+void GLWidget::SetClusterCulling(bool frustum, bool backface) {
+    cull_frustum_ = frustum;
+    cull_backfaces_ = backface;
+    update();
+}
+
+void GLWidget::UploadMesh(
+    std::unique_ptr<data_representation::TriangleMesh> mesh,
+    const data_representation::PackedVertices &vertices,
+    const data_representation::PackedIndices &indices,
+    const std::map<std::string, QImage> &images) {
+    // Release the buffers of the previous model.
+    if (mesh_ != nullptr) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO_v);
+        glDeleteBuffers(1, &VBO_i);
+        glDeleteVertexArrays(1, &VAO_sky);
+        glDeleteBuffers(1, &VBO_v_sky);
+        glDeleteBuffers(1, &VBO_i_sky);
+    }
+
+    mesh_ = std::move(mesh);
     camera_.UpdateModel(mesh_->min_, mesh_->max_);
     //mesh_->computeNormals();
 
@@ -151,32 +539,44 @@ bool GLWidget::LoadModel(const QString &filename) {
 
     // Create VBOs
     glGenBuffers(1, &VBO_v);
-    glGenBuffers(1, &VBO_n);
-    glGenBuffers(1, &VBO_tc);
     glGenBuffers(1, &VBO_i);
 
-    // Bind VBOs to VAO
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_v);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * mesh_->vertices_.size(), &mesh_->vertices_[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_n);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * mesh_->normals_.size(), &mesh_->normals_[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_tc);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * mesh_->texCoords_.size(), &mesh_->texCoords_[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(2);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBO_i);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int) * mesh_->faces_.size(), &mesh_->faces_[0], GL_STATIC_DRAW);
-
-    glBindVertexArray(0);
+    UploadVertices(vertices);
+    UploadIndices(indices);
+
+    // Materials sharing a texture file share the GL texture.
+    std::vector<GLuint> old_maps = material_maps_;
+    std::sort(old_maps.begin(), old_maps.end());
+    old_maps.erase(std::unique(old_maps.begin(), old_maps.end()), old_maps.end());
+    for (GLuint texture : old_maps)
+      if (texture != 0) glDeleteTextures(1, &texture);
+
+    std::map<std::string, GLuint> textures;
+    gpu_texture_bytes_ = 0;
+    material_maps_.assign(mesh_->materials_.size(), 0);
+    for (size_t i = 0; i < mesh_->materials_.size(); ++i) {
+      const std::string &path = mesh_->materials_[i].diffuse_map;
+      if (path.empty()) continue;
+
+      auto found = textures.find(path);
+      if (found == textures.end()) {
+        GLuint texture = 0;
+        auto image = images.find(path);
+        if (image != images.end() && !image->second.isNull()) {
+          glGenTextures(1, &texture);
+          glBindTexture(GL_TEXTURE_2D, texture);
+          UploadImage(image->second, GL_TEXTURE_2D);
+          gpu_texture_bytes_ += image->second.bytesPerLine() * image->second.height();
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        }
+        found = textures.insert(std::make_pair(path, texture)).first;
+      }
+      material_maps_[i] = found->second;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
 
     /*
      *
@@ -215,13 +615,9 @@ bool GLWidget::LoadModel(const QString &filename) {
 
     // TODO END.
 
-    emit SetFaces(QString(std::to_string(mesh_->faces_.size() / 3).c_str()));
+    emit SetFaces(QString(std::to_string(mesh_->FaceCount()).c_str()));
     emit SetVertices(
-        QString(std::to_string(mesh_->vertices_.size() / 3).c_str()));
-    return true;
-  }
-
-  return false;
+        QString(std::to_string(mesh_->VertexCount()).c_str()));
 }
 
 bool GLWidget::LoadSpecularMap(const QString &dir) {
@@ -305,6 +701,130 @@ void GLWidget::GenBufferTexture(GLuint buffer, GLuint* texture, GLenum attachmen
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+bool GLWidget::ReadQuery(GLuint query, bool *pending, GLuint64 *result) {
+  if (!*pending) return false;
+  GLint available = 0;
+  glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) return false;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, result);
+  *pending = false;
+  return true;
+}
+
+size_t GLWidget::SelectLod(const glm::mat4x4 &projection,
+                          const glm::mat4x4 &view,
+                          const glm::mat4x4 &model) const
+{
+    const size_t last = index_lods_.empty() ? 0 : index_lods_.size() - 1;
+    if (forced_lod_ >= 0) return std::min(static_cast<size_t>(forced_lod_), last);
+
+    // Errors are relative to the longest edge of the bounding box.
+    const glm::vec3 extent = mesh_->max_ - mesh_->min_;
+    const float longest = std::max(extent.x, std::max(extent.y, extent.z));
+    const glm::vec4 center((mesh_->min_ + mesh_->max_) * 0.5f, 1.0f);
+    const glm::vec4 view_center = view * model * center;
+    const float scale = glm::length(glm::vec3(model * glm::vec4(longest, 0.0f, 0.0f, 0.0f)));
+    const float radius = glm::length(extent) * 0.5f * scale / longest;
+    const float distance = -view_center.z - radius;
+    if (longest <= 0.0f || distance <= 0.0f) return 0;
+
+    // Pixels per unit of view space at the nearest point of the sphere.
+    const float pixels = projection[1][1] * 0.5f * height_ * devicePixelRatioF() / distance;
+    for (size_t lod = last; lod > 0; --lod)
+        if (index_lods_[lod].error * scale * pixels <= kMaxLodPixelError)
+            return lod;
+    return 0;
+}
+
+bool GLWidget::CullClusters(const glm::mat4x4 &projection,
+                            const glm::mat4x4 &view,
+                            const glm::mat4x4 &model)
+{
+    if (mesh_->meshlets_.empty() || (!cull_frustum_ && !cull_backfaces_)) {
+        emit SetCulling(QString());
+        return false;
+    }
+
+    const glm::mat4x4 model_view = view * model;
+    const glm::vec3 camera(glm::inverse(model_view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    data_representation::MeshletCullStats stats;
+    data_representation::CullMeshlets(mesh_->meshlets_, projection * model_view, camera,
+                                      cull_frustum_, cull_backfaces_,
+                                      &meshlet_visible_, &stats);
+    emit SetCulling(QString("Clusters: %1/%2 drawn, %3 outside, %4 backfacing, %5 triangles")
+                        .arg(stats.visible)
+                        .arg(mesh_->meshlets_.size())
+                        .arg(stats.frustum_culled)
+                        .arg(stats.backface_culled)
+                        .arg(stats.visible_triangles));
+    return true;
+}
+
+void GLWidget::DrawMesh(size_t lod, const std::vector<char> *visible_meshlets)
+{
+    const data_representation::IndexLod &level = index_lods_[lod];
+    const GLenum type = level.index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    const bool textured = !mesh_->submeshes_.empty();
+    const bool culled = lod == 0 && visible_meshlets != nullptr;
+    const std::vector<data_representation::Meshlet> &meshlets = mesh_->meshlets_;
+
+    std::vector<GLsizei> counts;
+    std::vector<const GLvoid *> offsets;
+    std::vector<GLint> base_vertices;
+    size_t meshlet = 0;
+
+    if (textured) glActiveTexture(GL_TEXTURE0);
+    for (const auto &chunk : level.chunks) {
+        if (textured) {
+            const int material = mesh_->submeshes_[chunk.submesh].material;
+            GLuint texture = material >= 0 ? material_maps_[material] : 0;
+            glBindTexture(GL_TEXTURE_2D, texture != 0 ? texture : color_map_);
+        }
+        if (!culled) {
+            glDrawElementsBaseVertex(GL_TRIANGLES, chunk.count, type,
+                                     (GLvoid*)(level.offset + level.index_size * chunk.first),
+                                     chunk.base_vertex);
+            continue;
+        }
+
+        // Meshlets may straddle the chunks of split index buffers, so their
+        // ranges are clipped to the chunk. Consecutive ranges are merged.
+        const size_t end = chunk.first + chunk.count;
+        counts.clear();
+        offsets.clear();
+        base_vertices.clear();
+        size_t run_first = 0, run_end = 0;
+        while (meshlet > 0 && meshlets[meshlet - 1].first + meshlets[meshlet - 1].count > chunk.first)
+            --meshlet;
+        for (; meshlet < meshlets.size() && meshlets[meshlet].first < end; ++meshlet) {
+            if (!(*visible_meshlets)[meshlet]) continue;
+            const size_t first = std::max<size_t>(meshlets[meshlet].first, chunk.first);
+            const size_t last = std::min<size_t>(meshlets[meshlet].first + meshlets[meshlet].count, end);
+            if (first >= last) continue;
+            if (first == run_end && run_end > run_first) {
+                run_end = last;
+                continue;
+            }
+            if (run_end > run_first) {
+                counts.push_back(static_cast<GLsizei>(run_end - run_first));
+                offsets.push_back((GLvoid*)(level.offset + level.index_size * run_first));
+            }
+            run_first = first;
+            run_end = last;
+        }
+        if (run_end > run_first) {
+            counts.push_back(static_cast<GLsizei>(run_end - run_first));
+            offsets.push_back((GLvoid*)(level.offset + level.index_size * run_first));
+        }
+        if (counts.empty()) continue;
+        base_vertices.assign(counts.size(), chunk.base_vertex);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), type, offsets.data(),
+                                      static_cast<GLsizei>(counts.size()),
+                                      base_vertices.data());
+    }
+    if (textured) glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void GLWidget::initializeGL ()
 {
     makeCurrent();
@@ -325,6 +845,8 @@ void GLWidget::initializeGL ()
   glGenTextures(1, &color_map_);
   glGenTextures(1, &roughness_map_);
   glGenTextures(1, &metalness_map_);
+  glGenQueries(1, &gbuffer_query_);
+  glGenQueries(1, &fragment_query_);
 
 
   /*
@@ -429,7 +951,17 @@ void GLWidget::initializeGL ()
 
   if (!res) exit(0);
 
-  LoadModel(".null");//create an sphere
+  std::unique_ptr<data_representation::TriangleMesh> sphere =
+      std::make_unique<data_representation::TriangleMesh>();
+  data_representation::CreateSphere(sphere.get());
+  bvh_.Build(*sphere);
+  data_representation::PackedIndices indices;
+  data_representation::PackIndices(*sphere, split_indices_, &indices);
+  data_representation::PackedVertices vertices;
+  data_representation::PackVertices(*sphere, vertex_format_, kShaderStreams,
+                                    indices.vertex_remap, &vertices);
+  UploadMesh(std::move(sphere), vertices, indices, {});
+  ReportResidency();
 
   initialized_ = true;
 }
@@ -446,6 +978,7 @@ void GLWidget::resizeGL (int w, int h)
 
 void GLWidget::mousePressEvent(QMouseEvent *event) {
   if (event->button() == Qt::LeftButton) {
+    Pick(event->x(), event->y());
     camera_.StartRotating(event->x(), event->y());
   }
   if (event->button() == Qt::RightButton) {
@@ -454,6 +987,34 @@ void GLWidget::mousePressEvent(QMouseEvent *event) {
   update();
 }
 
+void GLWidget::Pick(int x, int y) {
+  // The hierarchy keeps its own copy of the triangles, so picking works with
+  // the mesh arrays released.
+  if (bvh_.empty()) return;
+
+  // Unproject the point on the near and far planes into model space.
+  const glm::mat4x4 kInverse = glm::inverse(
+      camera_.SetProjection() * camera_.SetView() * camera_.SetModel());
+  const float kX = 2.0f * (x + 0.5f) / width_ - 1.0f;
+  const float kY = 1.0f - 2.0f * (y + 0.5f) / height_;
+  const glm::vec4 kNear = kInverse * glm::vec4(kX, kY, -1.0f, 1.0f);
+  const glm::vec4 kFar = kInverse * glm::vec4(kX, kY, 1.0f, 1.0f);
+  const glm::vec3 kOrigin = glm::vec3(kNear) / kNear.w;
+  const glm::vec3 kDirection = glm::vec3(kFar) / kFar.w - kOrigin;
+
+  data_representation::RayHit hit;
+  if (!bvh_.ClosestHit(kOrigin, kDirection, 1.0f, &hit)) {
+    emit SetPick(QString());
+    return;
+  }
+  const glm::vec3 kPoint = kOrigin + hit.t * kDirection;
+  emit SetPick(QString("Triangle %1 at (%2, %3, %4)")
+                   .arg(hit.triangle)
+                   .arg(kPoint[0], 0, 'g', 4)
+                   .arg(kPoint[1], 0, 'g', 4)
+                   .arg(kPoint[2], 0, 'g', 4));
+}
+
 void GLWidget::mouseMoveEvent(QMouseEvent *event) {
   camera_.SetRotationX(event->y());
   camera_.SetRotationY(event->x());
@@ -576,6 +1137,7 @@ void GLWidget::paintGL ()
 
             //*
             programs_[1]->bind();
+            SetVertexDecodeUniforms(programs_[1].get());
 
             projection_location       = programs_[currentShader_]->uniformLocation("projection");
             view_location             = programs_[currentShader_]->uniformLocation("view");
@@ -587,10 +1149,41 @@ void GLWidget::paintGL ()
             glUniformMatrix4fv(model_location, 1, GL_FALSE, &model[0][0]);
             glUniformMatrix3fv(normal_matrix_location, 1, GL_FALSE, &normal[0][0]);
 
+            // Query results are read on later frames so that the CPU never
+            // waits for the GPU, and frames are not measured meanwhile.
+            GLuint64 result = 0;
+            if (ReadQuery(gbuffer_query_, &gbuffer_query_pending_, &result))
+                emit SetGBufferTime(
+                    QString("%1 ms (LOD %2, %3 triangles)")
+                        .arg(result / 1.0e6, 0, 'f', 3)
+                        .arg(gbuffer_query_lod_)
+                        .arg(index_lods_[gbuffer_query_lod_].index_count() / 3));
+            if (count_fragments_ &&
+                ReadQuery(fragment_query_, &fragment_query_pending_, &result))
+                emit SetFragments(QString::number(result));
+
+            const size_t lod = SelectLod(projection, view, model);
+            const bool culled = lod == 0 && CullClusters(projection, view, model);
+            if (lod != 0) emit SetCulling(QString());
+            const bool timed = !gbuffer_query_pending_;
+            const bool counted = count_fragments_ && !fragment_query_pending_;
+            if (timed) glBeginQuery(GL_TIME_ELAPSED, gbuffer_query_);
+            if (counted) glBeginQuery(GL_SAMPLES_PASSED, fragment_query_);
+
             glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, mesh_->faces_.size(), GL_UNSIGNED_INT, (GLvoid*)nullptr);
+            DrawMesh(lod, culled ? &meshlet_visible_ : nullptr);
             glBindVertexArray(0);
 
+            if (counted) {
+                glEndQuery(GL_SAMPLES_PASSED);
+                fragment_query_pending_ = true;
+            }
+            if (timed) {
+                glEndQuery(GL_TIME_ELAPSED);
+                gbuffer_query_pending_ = true;
+                gbuffer_query_lod_ = lod;
+            }
+
             //STEP-2----------------------------------------------------------------------------------------
 
             // Bind and clear buffer
@@ -670,12 +1263,18 @@ void GLWidget::SetReflection(bool set) {
 }
 
 void GLWidget::SetPBS(bool set) {
-    if(set) currentShader_ = 3;
+    if(set) {
+        currentShader_ = 3;
+        CompleteVertexAttributes();
+    }
     update();
 }
 
 void GLWidget::SetIBLPBS(bool set) {
-    if(set) currentShader_ = 4;
+    if(set) {
+        currentShader_ = 4;
+        CompleteVertexAttributes();
+    }
     update();
 }
 
@@ -706,6 +1305,12 @@ void GLWidget::SetCurrentTexture(int i)
     currentTexture_ = i;
 }
 
+void GLWidget::SetCountFragments(bool set) {
+  count_fragments_ = set;
+  if (!set) emit SetFragments(QString());
+  update();
+}
+
 void GLWidget::SetSkyVisible(bool set)
 {
     skyVisible_ = set;
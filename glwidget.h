@@ -10,12 +10,22 @@
 #include <QImage>
 #include <QMouseEvent>
 #include <QString>
+#include <QThreadPool>
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "./bvh.h"
 #include "./camera.h"
+#include "./index_buffer.h"
+#include "./mesh_loader.h"
 #include "./triangle_mesh.h"
+#include "./vertex_format.h"
 
+#include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 
 class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
@@ -26,13 +36,77 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   ~GLWidget();
 
   /**
-   * @brief LoadModel Loads a PLY model at the filename path into the mesh_ data
-   * structure.
-   * @param filename Path to the PLY model.
-   * @return Whether it was able to load the model.
+   * @brief LoadModel Starts loading the PLY or OBJ model at the filename path
+   * on a worker thread. The current model keeps being rendered until the new
+   * one is uploaded, and ModelLoaded is emitted once the load finishes.
+   * @param filename Path to the PLY or OBJ model.
+   * @return Whether the load could be started.
    */
   bool LoadModel(const QString &filename);
 
+  /**
+   * @brief SetVertexFormat Selects the layout of the vertex buffer for the
+   * next loads and re-uploads the current mesh with it.
+   * @param format The vertex layout.
+   */
+  void SetVertexFormat(const data_representation::VertexFormat &format);
+
+  /**
+   * @brief SetSplitIndices Selects whether meshes with more vertices than 16-bit
+   * indices can address are split into chunks with 16-bit indices, and
+   * re-uploads the current mesh.
+   * @param split Whether to split.
+   */
+  void SetSplitIndices(bool split);
+
+  /**
+   * @brief SetForcedLod Draws a fixed level of detail of the current mesh, or
+   * the coarsest finer one if the mesh has fewer levels.
+   * @param lod The level, 0 for the full mesh, or -1 to select the level from
+   * the projected size of the mesh.
+   */
+  void SetForcedLod(int lod);
+
+  /**
+   * @brief SetCleanMesh Selects whether the next models loaded are cleaned up
+   * after parsing, see CleanMesh.
+   */
+  void SetCleanMesh(bool clean);
+
+  /**
+   * @brief SetSpatialSort Selects whether the vertices and triangles of the
+   * next models loaded are sorted along a Z-order curve, see SpatialSort.
+   */
+  void SetSpatialSort(bool sort);
+
+  /**
+   * @brief SetBakeOcclusion Selects whether the ambient occlusion of the next
+   * models loaded is baked, see BakeAmbientOcclusion. It is cached with the
+   * model, so only the first load pays for it.
+   */
+  void SetBakeOcclusion(bool bake);
+
+  /**
+   * @brief SetClusterCulling Selects which meshlets of the full mesh are
+   * culled on the CPU before the G-buffer pass.
+   * @param frustum Whether to cull the meshlets outside the view.
+   * @param backface Whether to cull the meshlets facing away from the camera.
+   */
+  void SetClusterCulling(bool frustum, bool backface);
+
+  /**
+   * @brief SetReleaseMeshArrays Selects whether the CPU copy of the arrays of
+   * the models is freed once they are on the GPU, see ReleaseMeshArrays.
+   * Applies to the current model too.
+   */
+  void SetReleaseMeshArrays(bool release);
+
+  /**
+   * @brief lod_count Maximum number of levels of detail of the loaded meshes,
+   * not counting the full mesh.
+   */
+  size_t lod_count() const { return load_options_.lod_count; }
+
   /**
    * @brief LoadSpecularMap Will load load a cube map that will be used for the
    * specular component.
@@ -79,6 +153,72 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
 
   void GenBufferTexture(GLuint buffer, GLuint* texture, GLenum attachment, GLenum format);
 
+  /**
+   * @brief DrawMesh Draws a level of detail of the bound mesh VAO, issuing one
+   * draw per index chunk with the diffuse texture of its material bound to
+   * texture unit 0.
+   * @param lod Index into index_lods_, 0 for the full mesh.
+   * @param visible_meshlets If not null, only the ranges of the visible
+   * meshlets of the full mesh are drawn, with one multi-draw per chunk.
+   */
+  void DrawMesh(size_t lod, const std::vector<char> *visible_meshlets);
+
+  /**
+   * @brief Pick Casts a ray from the camera through a point of the widget and
+   * reports the closest triangle hit with SetPick.
+   * @param x The X coordinate of the point, in widget pixels.
+   * @param y The Y coordinate of the point, in widget pixels.
+   */
+  void Pick(int x, int y);
+
+  /**
+   * @brief CullClusters Culls the meshlets of the full mesh and reports the
+   * result with SetCulling.
+   * @return Whether meshlet_visible_ holds the visible meshlets, which is not
+   * the case if culling is disabled or the mesh has no meshlets.
+   */
+  bool CullClusters(const glm::mat4x4 &projection, const glm::mat4x4 &view,
+                    const glm::mat4x4 &model);
+
+  /**
+   * @brief SelectLod Coarsest level of detail whose error, projected at the
+   * point of the bounding sphere of the mesh nearest to the camera, stays
+   * under kMaxLodPixelError pixels, unless a level is forced.
+   */
+  size_t SelectLod(const glm::mat4x4 &projection, const glm::mat4x4 &view,
+                   const glm::mat4x4 &model) const;
+
+  /**
+   * @brief ReadQuery Reads the result of a pending query without waiting.
+   * @param query The query object.
+   * @param pending Whether the query was issued. Cleared once it is read.
+   * @param result The result of the query.
+   * @return Whether a result was read.
+   */
+  bool ReadQuery(GLuint query, bool *pending, GLuint64 *result);
+
+  /**
+   * @brief EnsureMeshArrays Reloads the arrays of mesh_ if they were released,
+   * with the settings it was loaded with and the attributes of the current
+   * shader, and reports the new residency.
+   * @return Whether the arrays of mesh_ are resident.
+   */
+  bool EnsureMeshArrays();
+
+  /**
+   * @brief ReleaseMeshArrays Frees the arrays of mesh_, if enabled and mesh_
+   * can be reloaded from its file, and reports the new residency. Bounds,
+   * counts, submeshes and meshlets stay, which is all drawing needs, and
+   * bvh_ has its own copy of the triangles for picking.
+   */
+  void ReleaseMeshArrays();
+
+  /**
+   * @brief ReportResidency Reports the CPU and GPU memory of the current
+   * mesh with SetResidency.
+   */
+  void ReportResidency();
+
  protected:
   /**
    * @brief initializeGL Initializes OpenGL variables and loads, compiles and
@@ -93,6 +233,54 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
    */
   void resizeGL(int w, int h);
 
+  /**
+   * @brief UploadMesh Replaces mesh_ and its GL buffers and textures. Must be
+   * called with the GL context current.
+   * @param mesh The mesh to be rendered.
+   * @param vertices The vertices of mesh packed with PackVertices.
+   * @param indices The indices of mesh packed with PackIndices, which gave
+   * the vertex remap of vertices.
+   * @param images The decoded diffuse maps of the mesh materials, by path.
+   */
+  void UploadMesh(std::unique_ptr<data_representation::TriangleMesh> mesh,
+                  const data_representation::PackedVertices &vertices,
+                  const data_representation::PackedIndices &indices,
+                  const std::map<std::string, QImage> &images);
+
+  /**
+   * @brief UploadIndices Fills the index buffer of the mesh VAO and keeps the
+   * draws of its chunks. Must be called with the GL context current.
+   * @param indices The packed indices of mesh_.
+   */
+  void UploadIndices(const data_representation::PackedIndices &indices);
+
+  /**
+   * @brief RepackMesh Packs and uploads mesh_ again with the current vertex
+   * format and index splitting.
+   */
+  void RepackMesh();
+
+  /**
+   * @brief CompleteVertexAttributes Computes the vertex attributes that the
+   * current shader needs and mesh_ lacks, as loads only derive the ones of
+   * the shader active when they start, and repacks the mesh.
+   */
+  void CompleteVertexAttributes();
+
+  /**
+   * @brief UploadVertices Fills the interleaved vertex buffer and points the
+   * attributes of the mesh VAO at it. Must be called with the GL context
+   * current.
+   * @param vertices The packed vertices of mesh_.
+   */
+  void UploadVertices(const data_representation::PackedVertices &vertices);
+
+  /**
+   * @brief SetVertexDecodeUniforms Sets the uniforms that decode the uploaded
+   * vertex format. Needed by every bound program drawing the mesh.
+   */
+  void SetVertexDecodeUniforms(QOpenGLShaderProgram *program);
+
   void mousePressEvent(QMouseEvent *event);
   void mouseMoveEvent(QMouseEvent *event);
   void mouseReleaseEvent(QMouseEvent *event);
@@ -114,6 +302,114 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
    */
   std::unique_ptr<data_representation::TriangleMesh> mesh_;
 
+  /**
+   * @brief bvh_ Bounding volume hierarchy of mesh_, used for picking.
+   */
+  data_representation::Bvh bvh_;
+
+  /**
+   * @brief load_options_ Settings used when loading models.
+   */
+  data_representation::LoadOptions load_options_;
+
+  /**
+   * @brief mesh_file_ Path mesh_ was loaded from, empty for the built-in
+   * sphere, which is never released.
+   */
+  std::string mesh_file_;
+
+  /**
+   * @brief mesh_options_ Settings mesh_ was loaded with, used to reload its
+   * arrays from the same cache.
+   */
+  data_representation::LoadOptions mesh_options_;
+
+  /**
+   * @brief mesh_key_ Key of mesh_file_ when mesh_ was loaded, so that its
+   * arrays are only reloaded from the same content.
+   */
+  data_representation::SourceKey mesh_key_;
+
+  /**
+   * @brief release_mesh_arrays_ Whether the arrays of mesh_ are freed after
+   * every upload.
+   */
+  bool release_mesh_arrays_;
+
+  /**
+   * @brief released_attributes_ Vertex attributes mesh_ had when its arrays
+   * were released.
+   */
+  uint32_t released_attributes_;
+
+  /**
+   * @brief gpu_vertex_bytes_ Memory of the vertex buffer of mesh_, followed by
+   * that of its index buffer and diffuse maps.
+   */
+  uint64_t gpu_vertex_bytes_;
+  uint64_t gpu_index_bytes_;
+  uint64_t gpu_texture_bytes_;
+
+  /**
+   * @brief vertex_format_ Layout of the vertex buffer of the next uploads.
+   */
+  data_representation::VertexFormat vertex_format_;
+
+  /**
+   * @brief split_indices_ Whether the index buffers of the next uploads may be
+   * split, see PackIndices.
+   */
+  bool split_indices_;
+
+  /**
+   * @brief index_lods_ Levels of detail of the current index buffer.
+   */
+  std::vector<data_representation::IndexLod> index_lods_;
+
+  /**
+   * @brief cull_frustum_ Whether the meshlets outside the view are culled.
+   */
+  bool cull_frustum_;
+
+  /**
+   * @brief cull_backfaces_ Whether the backfacing meshlets are culled.
+   */
+  bool cull_backfaces_;
+
+  /**
+   * @brief meshlet_visible_ Result of the last CullClusters.
+   */
+  std::vector<char> meshlet_visible_;
+
+  /**
+   * @brief forced_lod_ Level of detail drawn regardless of the view, -1 to
+   * select it automatically.
+   */
+  int forced_lod_;
+
+  /**
+   * @brief uploaded_format_ Layout of the current vertex buffer.
+   */
+  data_representation::VertexFormat uploaded_format_;
+
+  /**
+   * @brief position_offset_ Decoding of the quantized positions of the
+   * current vertex buffer, see PackedVertices.
+   */
+  glm::vec3 position_offset_;
+  glm::vec3 position_scale_;
+
+  /**
+   * @brief load_pool_ Worker threads running the model loads.
+   */
+  QThreadPool load_pool_;
+
+  /**
+   * @brief load_generation_ Number of loads started. Only the latest one is
+   * uploaded when it finishes.
+   */
+  std::atomic<int> load_generation_;
+
   /**
    * @brief diffuse_map_ Diffuse cubemap texture.
    */
@@ -139,6 +435,12 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
    */
   GLuint metalness_map_;
 
+  /**
+   * @brief material_maps_ Diffuse texture of every material of the mesh, 0 if
+   * the material has none.
+   */
+  std::vector<GLuint> material_maps_;
+
   /**
    * @brief initialized_ Whether the widget has finished initializations.
    */
@@ -184,6 +486,42 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
    */
   float roughness_;
 
+  /**
+   * @brief gbuffer_query_ Timer query measuring the GPU time of the G-buffer
+   * pass.
+   */
+  GLuint gbuffer_query_;
+
+  /**
+   * @brief gbuffer_query_pending_ Whether gbuffer_query_ has been issued and
+   * its result not read yet. Results are read on later frames so that the
+   * CPU never waits for the GPU.
+   */
+  bool gbuffer_query_pending_;
+
+  /**
+   * @brief gbuffer_query_lod_ Level of detail drawn in the frame measured by
+   * gbuffer_query_.
+   */
+  size_t gbuffer_query_lod_;
+
+  /**
+   * @brief fragment_query_ Samples passed query counting the fragments that
+   * pass the depth test in the G-buffer pass, which are the shaded ones.
+   */
+  GLuint fragment_query_;
+
+  /**
+   * @brief fragment_query_pending_ Whether fragment_query_ has been issued
+   * and its result not read yet.
+   */
+  bool fragment_query_pending_;
+
+  /**
+   * @brief count_fragments_ Whether the shaded fragments are being counted.
+   */
+  bool count_fragments_;
+
   GLuint ssao_bf;
   GLuint ssao_a;
   GLuint ssao_n;
@@ -191,8 +529,6 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
 
   GLuint VAO;
   GLuint VBO_v;
-  GLuint VBO_n;
-  GLuint VBO_tc;
   GLuint VBO_i;
 
   GLuint VAO_sky;
@@ -258,6 +594,11 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
    */
   void SetSkyVisible(bool set);
 
+  /**
+   * @brief SetCountFragments Enables counting the fragments shaded per frame.
+   */
+  void SetCountFragments(bool set);
+
   /**
    * @brief SetFaces Signal that updates the interface label "Framerate".
    */
@@ -284,6 +625,52 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
    */
   void SetFramerate(QString);
 
+  /**
+   * @brief SetGBufferTime Signal carrying the GPU time of the last measured
+   * G-buffer pass, which is dominated by the vertex shader for large meshes.
+   */
+  void SetGBufferTime(QString);
+
+  /**
+   * @brief SetFragments Signal carrying the number of fragments shaded in the
+   * last measured G-buffer pass, empty when counting is disabled.
+   */
+  void SetFragments(QString);
+
+  /**
+   * @brief SetPick Signal carrying the triangle under the last click.
+   */
+  void SetPick(QString);
+
+  /**
+   * @brief SetCulling Signal carrying the meshlet culling statistics of the
+   * last frame, empty when no meshlets are culled.
+   */
+  void SetCulling(QString);
+
+  /**
+   * @brief SetResidency Signal carrying the CPU and GPU memory of the current
+   * mesh.
+   */
+  void SetResidency(QString);
+
+  /**
+   * @brief LoadProgress Signal reporting the stage and percentage of the model
+   * being loaded.
+   */
+  void LoadProgress(QString, int);
+
+  /**
+   * @brief ModelLoaded Signal emitted when a load started by LoadModel ends,
+   * with whether it succeeded and the path of the model.
+   */
+  void ModelLoaded(bool, QString);
+
+  /**
+   * @brief SetLoadProfile Signal carrying the JSON report of the stage timings
+   * of the last loaded model.
+   */
+  void SetLoadProfile(QString);
 
 
 };
@@ -0,0 +1,185 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <index_buffer.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+const size_t kMinGrain = 1 << 16;
+
+/**
+ * @brief kMaxDuplication Growth of the vertex buffer from splitting above
+ * which 32-bit indices take less memory.
+ */
+const double kMaxDuplication = 1.25;
+
+/**
+ * @brief WholeRanges One chunk per submesh, or for all the faces.
+ */
+void WholeRanges(const std::vector<int> &faces,
+                 const std::vector<Submesh> &submeshes,
+                 std::vector<IndexChunk> *chunks) {
+  chunks->clear();
+  for (size_t i = 0; i < submeshes.size(); ++i)
+    chunks->push_back(
+        {submeshes[i].first, submeshes[i].count, 0, static_cast<int>(i)});
+  if (chunks->empty())
+    chunks->push_back({0, static_cast<unsigned int>(faces.size()), 0, -1});
+}
+
+/**
+ * @brief AppendIndices Appends faces to the buffer, aligned to the index
+ * size, mapping every vertex through packed_of if it is not empty.
+ * @return The byte offset of the first index.
+ */
+template <typename T>
+size_t AppendIndices(const std::vector<int> &faces,
+                     const std::vector<int> &packed_of,
+                     std::vector<uint8_t> *data) {
+  const size_t kOffset = (data->size() + sizeof(T) - 1) / sizeof(T) * sizeof(T);
+  data->resize(kOffset + sizeof(T) * faces.size());
+  T *indices = reinterpret_cast<T *>(data->data() + kOffset);
+  ParallelFor(faces.size(), kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      indices[i] = static_cast<T>(packed_of.empty() ? faces[i]
+                                                    : packed_of[faces[i]]);
+  });
+  return kOffset;
+}
+
+/**
+ * @brief SplitRanges Cuts every range greedily into runs of triangles using
+ * at most kMaxShortIndexVertices vertices each. Every chunk gets its own copy
+ * of the vertices it uses, so vertices shared by consecutive chunks are
+ * duplicated.
+ * @param ranges The ranges to split.
+ * @param chunks The resulting chunks, with their base vertex.
+ * @param vertex_remap The source vertex of every chunk vertex.
+ * @param indices The chunk-local index of every corner.
+ */
+void SplitRanges(const TriangleMesh &mesh,
+                 const std::vector<IndexChunk> &ranges,
+                 std::vector<IndexChunk> *chunks,
+                 std::vector<int> *vertex_remap,
+                 std::vector<uint16_t> *indices) {
+  chunks->clear();
+  vertex_remap->clear();
+  indices->resize(mesh.faces_.size());
+
+  // owner tells which chunk local_of is valid for, so it is never reset.
+  std::vector<uint32_t> owner(mesh.vertices_.size() / 3, 0);
+  std::vector<uint16_t> local_of(owner.size());
+  uint32_t chunk = 0;
+  for (const IndexChunk &range : ranges) {
+    const size_t kEnd = range.first + range.count;
+    size_t begin = range.first;
+    size_t base = vertex_remap->size();
+    ++chunk;
+    for (size_t i = range.first; i < kEnd; i += 3) {
+      const int *kTriangle = &mesh.faces_[i];
+      size_t missing = 0;
+      for (size_t k = 0; k < 3; ++k)
+        if (owner[kTriangle[k]] != chunk &&
+            std::find(kTriangle, kTriangle + k, kTriangle[k]) ==
+                kTriangle + k)
+          ++missing;
+
+      if (vertex_remap->size() - base + missing > kMaxShortIndexVertices) {
+        chunks->push_back({static_cast<unsigned int>(begin),
+                           static_cast<unsigned int>(i - begin),
+                           static_cast<int>(base), range.submesh});
+        begin = i;
+        base = vertex_remap->size();
+        ++chunk;
+      }
+
+      for (size_t k = 0; k < 3; ++k) {
+        const int kVertex = kTriangle[k];
+        if (owner[kVertex] != chunk) {
+          owner[kVertex] = chunk;
+          local_of[kVertex] =
+              static_cast<uint16_t>(vertex_remap->size() - base);
+          vertex_remap->push_back(kVertex);
+        }
+        (*indices)[i + k] = local_of[kVertex];
+      }
+    }
+    if (kEnd > begin)
+      chunks->push_back({static_cast<unsigned int>(begin),
+                         static_cast<unsigned int>(kEnd - begin),
+                         static_cast<int>(base), range.submesh});
+  }
+}
+
+}  // namespace
+
+void PackIndices(const TriangleMesh &mesh, bool split, PackedIndices *packed) {
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  const std::vector<int> kIdentity;
+
+  packed->data.clear();
+  packed->lods.assign(1, IndexLod());
+  packed->vertex_remap.clear();
+  IndexLod &full = packed->lods[0];
+  WholeRanges(mesh.faces_, mesh.submeshes_, &full.chunks);
+  full.offset = 0;
+  full.error = 0.0f;
+  if (kVertices <= kMaxShortIndexVertices) {
+    full.index_size = sizeof(uint16_t);
+    AppendIndices<uint16_t>(mesh.faces_, kIdentity, &packed->data);
+  } else {
+    bool packed_split = false;
+    if (split) {
+      std::vector<IndexChunk> chunks;
+      std::vector<int> vertex_remap;
+      std::vector<uint16_t> indices;
+      SplitRanges(mesh, full.chunks, &chunks, &vertex_remap, &indices);
+      if (vertex_remap.size() <= kVertices * kMaxDuplication) {
+        full.index_size = sizeof(uint16_t);
+        packed->data.resize(sizeof(uint16_t) * indices.size());
+        memcpy(packed->data.data(), indices.data(), packed->data.size());
+        full.chunks.swap(chunks);
+        packed->vertex_remap.swap(vertex_remap);
+        packed_split = true;
+      }
+    }
+    if (!packed_split) {
+      full.index_size = sizeof(uint32_t);
+      AppendIndices<uint32_t>(mesh.faces_, kIdentity, &packed->data);
+    }
+  }
+
+  // The levels of detail use the first copy of every vertex.
+  std::vector<int> packed_of;
+  if (!packed->vertex_remap.empty()) {
+    packed_of.assign(kVertices, -1);
+    for (size_t i = packed->vertex_remap.size(); i-- > 0;)
+      packed_of[packed->vertex_remap[i]] = static_cast<int>(i);
+  }
+  const size_t kPackedVertices = packed->vertex_remap.empty()
+                                     ? kVertices
+                                     : packed->vertex_remap.size();
+  for (const MeshLod &lod : mesh.lods_) {
+    IndexLod level;
+    WholeRanges(lod.faces, lod.submeshes, &level.chunks);
+    level.error = lod.error;
+    if (kPackedVertices <= kMaxShortIndexVertices) {
+      level.index_size = sizeof(uint16_t);
+      level.offset =
+          AppendIndices<uint16_t>(lod.faces, packed_of, &packed->data);
+    } else {
+      level.index_size = sizeof(uint32_t);
+      level.offset =
+          AppendIndices<uint32_t>(lod.faces, packed_of, &packed->data);
+    }
+    packed->lods.push_back(level);
+  }
+}
+
+}  // namespace data_representation
@@ -0,0 +1,115 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef INDEX_BUFFER_H_
+#define INDEX_BUFFER_H_
+
+#include <triangle_mesh.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief kMaxShortIndexVertices Number of vertices addressable with 16-bit
+ * indices.
+ */
+const size_t kMaxShortIndexVertices = 1 << 16;
+
+/**
+ * @brief The IndexChunk struct Range of the index buffer drawn with one call.
+ */
+struct IndexChunk {
+  /**
+   * @brief first Offset of the first index of the chunk in its level.
+   */
+  unsigned int first;
+
+  /**
+   * @brief count Number of indices of the chunk.
+   */
+  unsigned int count;
+
+  /**
+   * @brief base_vertex Value added to every index of the chunk.
+   */
+  int base_vertex;
+
+  /**
+   * @brief submesh Index into TriangleMesh::submeshes_, -1 if the mesh has
+   * none.
+   */
+  int submesh;
+};
+
+/**
+ * @brief The IndexLod struct Indices of one level of detail.
+ */
+struct IndexLod {
+  /**
+   * @brief index_size Bytes per index, 2 or 4.
+   */
+  size_t index_size;
+
+  /**
+   * @brief offset Offset of the first index of the level in the buffer, in
+   * bytes. A multiple of index_size.
+   */
+  size_t offset;
+
+  /**
+   * @brief chunks Draws covering the level in order. No chunk crosses a
+   * submesh boundary.
+   */
+  std::vector<IndexChunk> chunks;
+
+  /**
+   * @brief error Geometric error of the level, see MeshLod. 0 for the full
+   * mesh.
+   */
+  float error;
+
+  size_t index_count() const {
+    return chunks.empty() ? 0 : chunks.back().first + chunks.back().count;
+  }
+};
+
+/**
+ * @brief The PackedIndices struct Index buffer ready to be uploaded, holding
+ * every level of detail one after the other.
+ */
+struct PackedIndices {
+  std::vector<uint8_t> data;
+
+  /**
+   * @brief lods The full mesh followed by the levels of detail of the mesh.
+   */
+  std::vector<IndexLod> lods;
+
+  /**
+   * @brief vertex_remap Mesh vertex of every vertex the indices refer to, to
+   * be passed to PackVertices. Empty if they refer to the mesh vertices.
+   */
+  std::vector<int> vertex_remap;
+};
+
+/**
+ * @brief PackIndices Builds the index buffer of a mesh with the smallest index
+ * type that fits. 16-bit indices are used if the mesh has at most
+ * kMaxShortIndexVertices vertices or, if split is set, if its triangles can
+ * be cut into runs using that many vertices each without duplicating many
+ * vertices between runs, which holds for meshes with good vertex locality.
+ * Otherwise indices are 32-bit. The levels of detail are small, so they are
+ * never split: they use 32-bit indices when there are more vertices than
+ * 16-bit indices can address.
+ * @param mesh The mesh.
+ * @param split Whether larger meshes may be split into chunks drawn with a
+ * base vertex, each with its own copy of its vertices.
+ * @param packed The resulting buffer.
+ */
+void PackIndices(const TriangleMesh &mesh, bool split, PackedIndices *packed);
+
+}  // namespace data_representation
+
+#endif  // INDEX_BUFFER_H_
@@ -0,0 +1,96 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <load_profile.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace data_representation {
+
+namespace {
+
+std::string EscapeJson(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+      escaped.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char code[8];
+      snprintf(code, sizeof(code), "\\u%04x", c);
+      escaped.append(code);
+    } else {
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+}  // namespace
+
+uint64_t PeakMemory() {
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void LoadProfile::Add(const std::string &name, double milliseconds,
+                      uint64_t bytes) {
+  stages_.push_back({name, milliseconds, bytes, PeakMemory()});
+}
+
+void LoadProfile::SetMetric(const std::string &name, double value) {
+  for (auto &metric : metrics_) {
+    if (metric.first == name) {
+      metric.second = value;
+      return;
+    }
+  }
+  metrics_.push_back(std::make_pair(name, value));
+}
+
+double LoadProfile::TotalMilliseconds() const {
+  double total = 0.0;
+  for (const auto &stage : stages_) total += stage.milliseconds;
+  return total;
+}
+
+std::string LoadProfile::ToJson(const std::string &filename) const {
+  std::ostringstream json;
+  json << "{\n  \"file\": \"" << EscapeJson(filename) << "\",\n"
+       << "  \"total_ms\": " << TotalMilliseconds() << ",\n"
+       << "  \"stages\": [";
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    const LoadStage &stage = stages_[i];
+    const double kBytesPerSecond =
+        stage.milliseconds > 0.0 ? stage.bytes / (stage.milliseconds / 1000.0)
+                                 : 0.0;
+    json << (i > 0 ? "," : "") << "\n    {\"name\": \""
+         << EscapeJson(stage.name) << "\", \"ms\": " << stage.milliseconds
+         << ", \"bytes\": " << stage.bytes
+         << ", \"bytes_per_second\": " << static_cast<uint64_t>(kBytesPerSecond)
+         << ", \"peak_memory\": " << stage.peak_memory << "}";
+  }
+  json << "\n  ],\n  \"metrics\": {";
+  for (size_t i = 0; i < metrics_.size(); ++i)
+    json << (i > 0 ? "," : "") << "\n    \"" << EscapeJson(metrics_[i].first)
+         << "\": " << metrics_[i].second;
+  json << (metrics_.empty() ? "}" : "\n  }") << "\n}\n";
+  return json.str();
+}
+
+}  // namespace data_representation
@@ -0,0 +1,129 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef LOAD_PROFILE_H_
+#define LOAD_PROFILE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief The LoadStage struct Measurements of one stage of a mesh load.
+ */
+struct LoadStage {
+  std::string name;
+
+  /**
+   * @brief milliseconds Wall time spent in the stage.
+   */
+  double milliseconds;
+
+  /**
+   * @brief bytes Amount of data processed by the stage.
+   */
+  uint64_t bytes;
+
+  /**
+   * @brief peak_memory Peak resident memory of the process, in bytes, at the
+   * end of the stage. 0 if it is not available on this platform.
+   */
+  uint64_t peak_memory;
+};
+
+/**
+ * @brief The LoadProfile class Ordered list of the stages of a mesh load. It
+ * is not thread safe: a profile is filled by one load at a time.
+ */
+class LoadProfile {
+ public:
+  /**
+   * @brief Add Appends a stage, sampling the current peak memory.
+   */
+  void Add(const std::string &name, double milliseconds, uint64_t bytes);
+
+  /**
+   * @brief SetMetric Records a named value that is not a stage, such as a
+   * quality measure of the loaded mesh. Setting an existing name replaces it.
+   */
+  void SetMetric(const std::string &name, double value);
+
+  void Clear() {
+    stages_.clear();
+    metrics_.clear();
+  }
+
+  const std::vector<LoadStage> &stages() const { return stages_; }
+
+  const std::vector<std::pair<std::string, double>> &metrics() const {
+    return metrics_;
+  }
+
+  /**
+   * @brief TotalMilliseconds Sum of the wall time of all the stages.
+   */
+  double TotalMilliseconds() const;
+
+  /**
+   * @brief ToJson Serializes the profile as a JSON object with the source
+   * path, the total time, one entry per stage including its throughput and
+   * the metrics.
+   * @param filename The path of the loaded mesh.
+   */
+  std::string ToJson(const std::string &filename) const;
+
+ private:
+  std::vector<LoadStage> stages_;
+  std::vector<std::pair<std::string, double>> metrics_;
+};
+
+/**
+ * @brief The ScopedStage class Times the enclosing scope and adds it to a
+ * profile when destroyed. Does nothing if the profile is null.
+ */
+class ScopedStage {
+ public:
+  ScopedStage(LoadProfile *profile, const std::string &name,
+              uint64_t bytes = 0)
+      : profile_(profile),
+        name_(name),
+        bytes_(bytes),
+        start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedStage() {
+    if (profile_ == nullptr) return;
+    profile_->Add(name_,
+                  std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start_)
+                      .count(),
+                  bytes_);
+  }
+
+  ScopedStage(const ScopedStage &) = delete;
+  ScopedStage &operator=(const ScopedStage &) = delete;
+
+  /**
+   * @brief set_bytes Sets the amount of data processed, for stages that only
+   * know it once they are done.
+   */
+  void set_bytes(uint64_t bytes) { bytes_ = bytes; }
+
+ private:
+  LoadProfile *profile_;
+  std::string name_;
+  uint64_t bytes_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief PeakMemory Peak resident memory of the process in bytes, or 0 if it
+ * cannot be queried.
+ */
+uint64_t PeakMemory();
+
+}  // namespace data_representation
+
+#endif  // LOAD_PROFILE_H_
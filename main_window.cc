@@ -2,15 +2,132 @@
 
 #include <main_window.h>
 
+#include <QActionGroup>
+#include <QDockWidget>
+#include <QFile>
 #include <QFileDialog>
+#include <QMenuBar>
 #include <QMessageBox>
+#include <QStatusBar>
+#include <QTextStream>
+
+#include <utility>
+#include <vector>
+
 #include "./ui_main_window.h"
+#include "./vertex_format.h"
 
 namespace gui {
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::MainWindow) {
   ui->setupUi(this);
+
+  load_progress_ = new QProgressBar(this);
+  load_progress_->setRange(0, 100);
+  load_progress_->setMaximumWidth(200);
+  load_progress_->hide();
+  statusBar()->addPermanentWidget(load_progress_);
+  gbuffer_time_ = new QLabel(this);
+  statusBar()->addPermanentWidget(gbuffer_time_);
+  fragments_ = new QLabel(this);
+  statusBar()->addPermanentWidget(fragments_);
+  culling_ = new QLabel(this);
+  statusBar()->addPermanentWidget(culling_);
+  pick_ = new QLabel(this);
+  statusBar()->addPermanentWidget(pick_);
+  residency_ = new QLabel(this);
+  statusBar()->addPermanentWidget(residency_);
+
+  load_report_ = new QPlainTextEdit(this);
+  load_report_->setReadOnly(true);
+  QDockWidget *dock = new QDockWidget(tr("Load profile"), this);
+  dock->setWidget(load_report_);
+  addDockWidget(Qt::BottomDockWidgetArea, dock);
+  ui->menuFile->addAction(tr("Save Load Profile..."), this,
+                          &MainWindow::SaveLoadProfile);
+
+  QMenu *view = menuBar()->addMenu(tr("View"));
+  QAction *count_fragments = view->addAction(tr("Count Shaded Fragments"));
+  count_fragments->setCheckable(true);
+  connect(count_fragments, SIGNAL(toggled(bool)), ui->glwidget,
+          SLOT(SetCountFragments(bool)));
+
+  using data_representation::NormalFormat;
+  using data_representation::VertexFormat;
+  const std::vector<std::pair<QString, VertexFormat>> kFormats = {
+      {tr("Float Vertices"), data_representation::kFloatVertexFormat},
+      {tr("Compact Vertices"), data_representation::kCompactVertexFormat},
+      {tr("Compact Vertices, Octahedral Normals"),
+       {data_representation::kCompactVertexFormat.positions,
+        NormalFormat::kOctahedral,
+        data_representation::kCompactVertexFormat.tex_coords}}};
+  QActionGroup *formats = new QActionGroup(this);
+  view->addSeparator();
+  for (size_t i = 0; i < kFormats.size(); ++i) {
+    QAction *action = view->addAction(kFormats[i].first);
+    action->setCheckable(true);
+    action->setChecked(i == 1);
+    formats->addAction(action);
+    const VertexFormat kFormat = kFormats[i].second;
+    connect(action, &QAction::triggered, this,
+            [this, kFormat]() { ui->glwidget->SetVertexFormat(kFormat); });
+  }
+
+  view->addSeparator();
+  QAction *split_indices = view->addAction(tr("Split Large Index Buffers"));
+  split_indices->setCheckable(true);
+  split_indices->setChecked(true);
+  connect(split_indices, &QAction::toggled, this,
+          [this](bool split) { ui->glwidget->SetSplitIndices(split); });
+
+  view->addSeparator();
+  QActionGroup *lods = new QActionGroup(this);
+  for (int lod = -1; lod <= static_cast<int>(ui->glwidget->lod_count());
+       ++lod) {
+    QAction *action = view->addAction(
+        lod < 0 ? tr("Automatic Level of Detail") : tr("LOD %1").arg(lod));
+    action->setCheckable(true);
+    action->setChecked(lod < 0);
+    lods->addAction(action);
+    connect(action, &QAction::triggered, this,
+            [this, lod]() { ui->glwidget->SetForcedLod(lod); });
+  }
+
+  view->addSeparator();
+  QAction *clean_mesh = view->addAction(tr("Clean Up Meshes on Load"));
+  clean_mesh->setCheckable(true);
+  connect(clean_mesh, &QAction::toggled, this,
+          [this](bool clean) { ui->glwidget->SetCleanMesh(clean); });
+  QAction *spatial_sort = view->addAction(tr("Sort Meshes Spatially on Load"));
+  spatial_sort->setCheckable(true);
+  connect(spatial_sort, &QAction::toggled, this,
+          [this](bool sort) { ui->glwidget->SetSpatialSort(sort); });
+  QAction *bake_occlusion =
+      view->addAction(tr("Bake Ambient Occlusion on Load"));
+  bake_occlusion->setCheckable(true);
+  connect(bake_occlusion, &QAction::toggled, this,
+          [this](bool bake) { ui->glwidget->SetBakeOcclusion(bake); });
+  QAction *release_arrays =
+      view->addAction(tr("Free Mesh Memory After Upload"));
+  release_arrays->setCheckable(true);
+  release_arrays->setChecked(true);
+  connect(release_arrays, &QAction::toggled, this, [this](bool release) {
+    ui->glwidget->SetReleaseMeshArrays(release);
+  });
+
+  view->addSeparator();
+  QAction *cull_frustum = view->addAction(tr("Cull Clusters Outside the View"));
+  QAction *cull_backfaces = view->addAction(tr("Cull Backfacing Clusters"));
+  for (QAction *action : {cull_frustum, cull_backfaces}) {
+    action->setCheckable(true);
+    action->setChecked(true);
+    connect(action, &QAction::toggled, this, [this, cull_frustum,
+                                               cull_backfaces]() {
+      ui->glwidget->SetClusterCulling(cull_frustum->isChecked(),
+                                      cull_backfaces->isChecked());
+    });
+  }
 }
 
 MainWindow::~MainWindow() { delete ui; }
@@ -31,6 +148,59 @@ void MainWindow::on_actionLoad_triggered() {
   }
 }
 
+void MainWindow::on_glwidget_LoadProgress(QString stage, int percent) {
+  statusBar()->showMessage(stage);
+  load_progress_->setValue(percent);
+  load_progress_->show();
+}
+
+void MainWindow::on_glwidget_ModelLoaded(bool loaded, QString filename) {
+  statusBar()->clearMessage();
+  load_progress_->hide();
+  if (!loaded)
+    QMessageBox::warning(this, tr("Error"),
+                         tr("The file %1 could not be opened").arg(filename));
+}
+
+void MainWindow::on_glwidget_SetGBufferTime(QString time) {
+  gbuffer_time_->setText(tr("G-buffer: %1").arg(time));
+}
+
+void MainWindow::on_glwidget_SetFragments(QString fragments) {
+  fragments_->setText(fragments.isEmpty() ? QString()
+                                          : tr("Fragments: %1").arg(fragments));
+}
+
+void MainWindow::on_glwidget_SetCulling(QString culling) {
+  culling_->setText(culling);
+}
+
+void MainWindow::on_glwidget_SetPick(QString pick) {
+  pick_->setText(pick);
+}
+
+void MainWindow::on_glwidget_SetResidency(QString residency) {
+  residency_->setText(residency);
+}
+
+void MainWindow::on_glwidget_SetLoadProfile(QString report) {
+  load_report_->setPlainText(report);
+}
+
+void MainWindow::SaveLoadProfile() {
+  QString filename = QFileDialog::getSaveFileName(
+      this, tr("Save load profile"), "./", tr("JSON Files ( *.json )"));
+  if (filename.isNull()) return;
+
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    QMessageBox::warning(this, tr("Error"),
+                         tr("The file could not be opened"));
+    return;
+  }
+  QTextStream(&file) << load_report_->toPlainText();
+}
+
 void MainWindow::on_actionLoad_Specular_triggered() {
   QString dir =
       QFileDialog::getExistingDirectory(this, "Specular CubeMap folder.", "./");
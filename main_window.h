@@ -3,7 +3,10 @@
 #ifndef MAIN_WINDOW_H_
 #define MAIN_WINDOW_H_
 
+#include <QLabel>
 #include <QMainWindow>
+#include <QPlainTextEdit>
+#include <QProgressBar>
 
 namespace Ui {
 class MainWindow;
@@ -61,8 +64,92 @@ class MainWindow : public QMainWindow {
    */
   void on_actionLoad_Metalness_triggered();
 
+  /**
+   * @brief on_glwidget_LoadProgress Shows the progress of the model being
+   * loaded in the status bar.
+   */
+  void on_glwidget_LoadProgress(QString stage, int percent);
+
+  /**
+   * @brief on_glwidget_ModelLoaded Clears the load progress and reports
+   * failed loads.
+   */
+  void on_glwidget_ModelLoaded(bool loaded, QString filename);
+
+  /**
+   * @brief on_glwidget_SetLoadProfile Shows the load profile of the last model.
+   */
+  void on_glwidget_SetLoadProfile(QString report);
+
+  /**
+   * @brief on_glwidget_SetGBufferTime Shows the GPU time of the G-buffer pass.
+   */
+  void on_glwidget_SetGBufferTime(QString time);
+
+  /**
+   * @brief on_glwidget_SetFragments Shows the number of shaded fragments.
+   */
+  void on_glwidget_SetFragments(QString fragments);
+
+  /**
+   * @brief on_glwidget_SetCulling Shows the meshlet culling statistics.
+   */
+  void on_glwidget_SetCulling(QString culling);
+
+  /**
+   * @brief on_glwidget_SetPick Shows the triangle under the last click.
+   */
+  void on_glwidget_SetPick(QString pick);
+
+  /**
+   * @brief on_glwidget_SetResidency Shows the memory of the current mesh.
+   */
+  void on_glwidget_SetResidency(QString residency);
+
+  /**
+   * @brief SaveLoadProfile Opens a file dialog to store the last load profile
+   * as JSON.
+   */
+  void SaveLoadProfile();
+
  private:
   Ui::MainWindow *ui;
+
+  /**
+   * @brief load_progress_ Status bar indicator of the model being loaded.
+   */
+  QProgressBar *load_progress_;
+
+  /**
+   * @brief gbuffer_time_ Status bar label with the G-buffer pass GPU time.
+   */
+  QLabel *gbuffer_time_;
+
+  /**
+   * @brief fragments_ Status bar label with the shaded fragments per frame.
+   */
+  QLabel *fragments_;
+
+  /**
+   * @brief culling_ Status bar label with the culled meshlets per frame.
+   */
+  QLabel *culling_;
+
+  /**
+   * @brief pick_ Status bar label with the triangle under the last click.
+   */
+  QLabel *pick_;
+
+  /**
+   * @brief residency_ Status bar label with the CPU and GPU memory of the
+   * current mesh.
+   */
+  QLabel *residency_;
+
+  /**
+   * @brief load_report_ Dock view of the JSON load profile.
+   */
+  QPlainTextEdit *load_report_;
 };
 
 }  //  namespace gui
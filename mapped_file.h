@@ -0,0 +1,49 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace data_representation {
+
+/**
+ * @brief The MappedFile class Read-only memory mapping of a whole file. The
+ * mapping is released when the object is destroyed.
+ */
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /**
+   * @brief Open Maps the file at the path filename.
+   * @param filename The path to the file.
+   * @return Whether it was able to map the file.
+   */
+  bool Open(const std::string &filename);
+
+  /**
+   * @brief Close Unmaps the file, if any.
+   */
+  void Close();
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char *data_;
+  size_t size_;
+#ifdef _WIN32
+  void *file_;
+  void *mapping_;
+#endif
+};
+
+}  // namespace data_representation
+
+#endif  // MAPPED_FILE_H_
@@ -0,0 +1,146 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <mesh_adjacency.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+const size_t kMinGrain = 1 << 14;
+
+/**
+ * @brief ExclusiveScan Turns counts[0, n) into offsets[0, n] in parallel: the
+ * per-chunk sums are computed first, then every chunk scans its own range.
+ */
+template <typename Count>
+void ExclusiveScan(size_t n, const Count &count,
+                   std::vector<uint32_t> *offsets) {
+  offsets->resize(n + 1);
+  const size_t kChunks = NumChunks(n, kMinGrain);
+  std::vector<uint32_t> sums(kChunks + 1, 0);
+  ParallelForChunks(n, kChunks, [&](size_t chunk, size_t begin, size_t end) {
+    uint32_t sum = 0;
+    for (size_t i = begin; i < end; ++i) sum += count(i);
+    sums[chunk + 1] = sum;
+  });
+  for (size_t chunk = 0; chunk < kChunks; ++chunk)
+    sums[chunk + 1] += sums[chunk];
+  ParallelForChunks(n, kChunks, [&](size_t chunk, size_t begin, size_t end) {
+    uint32_t offset = sums[chunk];
+    for (size_t i = begin; i < end; ++i) {
+      (*offsets)[i] = offset;
+      offset += count(i);
+    }
+  });
+  (*offsets)[n] = sums[kChunks];
+}
+
+/**
+ * @brief CollectNeighbors Sorted, unique vertices sharing a face with v.
+ */
+void CollectNeighbors(const std::vector<int> &faces,
+                      const CsrAdjacency &vertex_corners, size_t v,
+                      std::vector<uint32_t> *neighbors) {
+  neighbors->clear();
+  for (const uint32_t *corner = vertex_corners.Begin(v);
+       corner != vertex_corners.End(v); ++corner) {
+    const size_t kFace = *corner / 3 * 3;
+    const size_t kK = *corner % 3;
+    neighbors->push_back(faces[kFace + (kK + 1) % 3]);
+    neighbors->push_back(faces[kFace + (kK + 2) % 3]);
+  }
+  std::sort(neighbors->begin(), neighbors->end());
+  neighbors->erase(std::unique(neighbors->begin(), neighbors->end()),
+                   neighbors->end());
+  // Degenerate faces may reference v itself.
+  neighbors->erase(std::remove(neighbors->begin(), neighbors->end(),
+                               static_cast<uint32_t>(v)),
+                   neighbors->end());
+}
+
+}  // namespace
+
+void BuildVertexCorners(const std::vector<int> &faces, size_t vertex_count,
+                        CsrAdjacency *adjacency) {
+  const size_t kCorners = faces.size();
+  std::unique_ptr<std::atomic<uint32_t>[]> counts(
+      new std::atomic<uint32_t>[vertex_count]);
+  ParallelFor(vertex_count, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v)
+      counts[v].store(0, std::memory_order_relaxed);
+  });
+  ParallelFor(kCorners, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      counts[faces[c]].fetch_add(1, std::memory_order_relaxed);
+  });
+
+  ExclusiveScan(vertex_count,
+                [&](size_t v) {
+                  return counts[v].load(std::memory_order_relaxed);
+                },
+                &adjacency->offsets);
+
+  // The counts become the write cursors of every vertex.
+  ParallelFor(vertex_count, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v)
+      counts[v].store(adjacency->offsets[v], std::memory_order_relaxed);
+  });
+  adjacency->indices.resize(kCorners);
+  ParallelFor(kCorners, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      adjacency->indices[counts[faces[c]].fetch_add(
+          1, std::memory_order_relaxed)] = static_cast<uint32_t>(c);
+  });
+
+  // The fill order depends on the scheduling; sorting keeps the result
+  // deterministic. Lists are short, so insertion sort is enough.
+  ParallelFor(vertex_count, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      uint32_t *list = adjacency->indices.data() + adjacency->offsets[v];
+      const size_t kSize = adjacency->Count(v);
+      for (size_t i = 1; i < kSize; ++i)
+        for (size_t j = i; j > 0 && list[j - 1] > list[j]; --j)
+          std::swap(list[j - 1], list[j]);
+    }
+  });
+}
+
+void BuildVertexNeighbors(const std::vector<int> &faces,
+                          const CsrAdjacency &vertex_corners,
+                          CsrAdjacency *adjacency) {
+  const size_t kVertices = vertex_corners.size();
+
+  // Neighbours are collected twice, to count and to fill, instead of being
+  // stored per vertex in between.
+  std::vector<uint32_t> counts(kVertices);
+  ParallelFor(kVertices, kMinGrain, [&](size_t begin, size_t end) {
+    std::vector<uint32_t> neighbors;
+    for (size_t v = begin; v < end; ++v) {
+      CollectNeighbors(faces, vertex_corners, v, &neighbors);
+      counts[v] = static_cast<uint32_t>(neighbors.size());
+    }
+  });
+
+  ExclusiveScan(kVertices, [&](size_t v) { return counts[v]; },
+                &adjacency->offsets);
+  std::vector<uint32_t>().swap(counts);
+
+  adjacency->indices.resize(adjacency->offsets[kVertices]);
+  ParallelFor(kVertices, kMinGrain, [&](size_t begin, size_t end) {
+    std::vector<uint32_t> neighbors;
+    for (size_t v = begin; v < end; ++v) {
+      CollectNeighbors(faces, vertex_corners, v, &neighbors);
+      std::copy(neighbors.begin(), neighbors.end(),
+                adjacency->indices.begin() + adjacency->offsets[v]);
+    }
+  });
+}
+
+}  // namespace data_representation
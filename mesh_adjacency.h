@@ -0,0 +1,67 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef MESH_ADJACENCY_H_
+#define MESH_ADJACENCY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief The CsrAdjacency struct Compressed sparse rows: the neighbours of
+ * item i are indices[offsets[i]] to indices[offsets[i + 1] - 1].
+ */
+struct CsrAdjacency {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> indices;
+
+  /**
+   * @brief size Number of items, 0 if the adjacency has not been built.
+   */
+  size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+  bool empty() const { return offsets.empty(); }
+
+  uint32_t Count(size_t i) const { return offsets[i + 1] - offsets[i]; }
+  const uint32_t *Begin(size_t i) const {
+    return indices.data() + offsets[i];
+  }
+  const uint32_t *End(size_t i) const {
+    return indices.data() + offsets[i + 1];
+  }
+
+  void Clear() {
+    offsets.clear();
+    indices.clear();
+  }
+};
+
+/**
+ * @brief BuildVertexCorners Vertex-to-face adjacency built with a parallel
+ * counting sort. The corners (face * 3 + k) referencing every vertex are
+ * stored instead of the faces, so that users also know the position of the
+ * vertex in the face; the face is corner / 3. The corners of a vertex are
+ * sorted in face order.
+ * @param faces Three vertex indices per triangle.
+ * @param vertex_count The number of vertices.
+ * @param adjacency The resulting vertex-to-corner adjacency.
+ */
+void BuildVertexCorners(const std::vector<int> &faces, size_t vertex_count,
+                        CsrAdjacency *adjacency);
+
+/**
+ * @brief BuildVertexNeighbors Vertex-to-vertex adjacency: the vertices sharing
+ * an edge with every vertex, sorted and without duplicates.
+ * @param faces Three vertex indices per triangle.
+ * @param vertex_corners The adjacency returned by BuildVertexCorners.
+ * @param adjacency The resulting vertex-to-vertex adjacency.
+ */
+void BuildVertexNeighbors(const std::vector<int> &faces,
+                          const CsrAdjacency &vertex_corners,
+                          CsrAdjacency *adjacency);
+
+}  // namespace data_representation
+
+#endif  // MESH_ADJACENCY_H_
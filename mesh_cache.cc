@@ -0,0 +1,537 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <mesh_cache.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "./mapped_file.h"
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+const char kMagic[8] = {'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H'};
+const uint32_t kVersion = 5;
+const uint64_t kPageSize = 4096;
+const size_t kHashBlock = 1 << 22;
+
+enum CacheSectionTag : uint32_t {
+  kSourcePath = 1,
+  kVertices = 2,
+  kFaces = 3,
+  kNormals = 4,
+  kTexCoords = 5,
+  kDiffuseMap = 6,
+  kSubmeshes = 7,
+  kMaterials = 8,
+  kLodFaces = 9,
+  kLods = 10,
+  kLodSubmeshes = 11,
+  kMeshlets = 12,
+  kStreams = 14,
+  kStreamNames = 15,
+  kStreamData = 16
+};
+
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t sections;
+  uint32_t post_process;
+  uint32_t reserved;
+  uint64_t source_size;
+  int64_t source_mtime;
+  uint64_t source_hash;
+  float min[3];
+  float max[3];
+};
+
+struct CacheSection {
+  uint32_t tag;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+};
+
+/**
+ * @brief The CacheLod struct Record of a level of detail, whose faces and
+ * submeshes follow those of the previous levels in their sections.
+ */
+struct CacheLod {
+  uint32_t face_count;
+  uint32_t submesh_count;
+  float error;
+  uint32_t reserved;
+};
+
+/**
+ * @brief The CacheStream struct Record of a vertex stream. Its name and its
+ * data follow those of the previous streams, in the stream names section and
+ * in a stream data section of its own.
+ */
+struct CacheStream {
+  uint32_t type;
+  uint32_t components;
+  uint32_t stride;
+  uint32_t reserved;
+  float offset;
+  float scale;
+};
+
+/**
+ * @brief The CacheBlob struct Contents of a section to be written.
+ */
+struct CacheBlob {
+  uint32_t tag;
+  const void *data;
+  uint64_t size;
+};
+
+bool SourceStatus(const std::string &filename, uint64_t *size,
+                  int64_t *mtime) {
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0) return false;
+  *size = static_cast<uint64_t>(info.st_size);
+  *mtime = static_cast<int64_t>(info.st_mtime);
+  return true;
+}
+
+inline uint64_t Mix(uint64_t hash, uint64_t value) {
+  hash ^= value;
+  hash *= 0x9E3779B97F4A7C15ull;
+  return hash ^ (hash >> 29);
+}
+
+/**
+ * @brief HashBytes 64-bit content hash. Fixed-size blocks are hashed in
+ * parallel and combined in order, so the result does not depend on the
+ * number of threads.
+ */
+uint64_t HashBytes(const char *data, size_t size) {
+  const size_t kBlocks = (size + kHashBlock - 1) / kHashBlock;
+  std::vector<uint64_t> hashes(kBlocks);
+
+  ParallelFor(kBlocks, 1, [&](size_t begin, size_t end) {
+    for (size_t b = begin; b < end; ++b) {
+      const char *block = data + b * kHashBlock;
+      const size_t kSize = std::min(kHashBlock, size - b * kHashBlock);
+      uint64_t hash = 0xCBF29CE484222325ull;
+      size_t i = 0;
+      for (; i + sizeof(uint64_t) <= kSize; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, block + i, sizeof(uint64_t));
+        hash = Mix(hash, word);
+      }
+      for (; i < kSize; ++i)
+        hash = Mix(hash, static_cast<unsigned char>(block[i]));
+      hashes[b] = hash;
+    }
+  });
+
+  uint64_t hash = Mix(0xCBF29CE484222325ull, size);
+  for (uint64_t block_hash : hashes) hash = Mix(hash, block_hash);
+  return hash;
+}
+
+bool HashFile(const std::string &filename, uint64_t *hash) {
+  MappedFile file;
+  if (!file.Open(filename)) return false;
+  *hash = HashBytes(file.data(), file.size());
+  return true;
+}
+
+uint64_t AlignToPage(uint64_t offset) {
+  return (offset + kPageSize - 1) / kPageSize * kPageSize;
+}
+
+bool SectionInFile(const MappedFile &file, const CacheSection &section) {
+  return section.offset <= file.size() &&
+         section.size <= file.size() - section.offset;
+}
+
+template <typename T>
+bool CopySection(const MappedFile &file, const CacheSection &section,
+                 std::vector<T> *values) {
+  if (!SectionInFile(file, section) || section.size % sizeof(T) != 0)
+    return false;
+
+  values->resize(section.size / sizeof(T));
+  char *destination = reinterpret_cast<char *>(values->data());
+  const char *source = file.data() + section.offset;
+  ParallelFor(section.size, 1 << 22, [&](size_t begin, size_t end) {
+    memcpy(destination + begin, source + begin, end - begin);
+  });
+  return true;
+}
+
+bool CopySection(const MappedFile &file, const CacheSection &section,
+                 std::string *value) {
+  if (!SectionInFile(file, section)) return false;
+  value->assign(file.data() + section.offset, section.size);
+  return true;
+}
+
+/**
+ * @brief PackMaterials Serializes the materials as null-terminated name and
+ * diffuse map pairs.
+ */
+std::string PackMaterials(const std::vector<Material> &materials) {
+  std::string packed;
+  for (const auto &material : materials) {
+    packed.append(material.name).push_back('\0');
+    packed.append(material.diffuse_map).push_back('\0');
+  }
+  return packed;
+}
+
+/**
+ * @brief SplitFields Splits a sequence of null-terminated strings.
+ */
+bool SplitFields(const std::string &packed, std::vector<std::string> *fields) {
+  for (size_t begin = 0; begin < packed.size();) {
+    const size_t kEnd = packed.find('\0', begin);
+    if (kEnd == std::string::npos) return false;
+    fields->push_back(packed.substr(begin, kEnd - begin));
+    begin = kEnd + 1;
+  }
+  return true;
+}
+
+bool UnpackMaterials(const std::string &packed,
+                     std::vector<Material> *materials) {
+  std::vector<std::string> fields;
+  if (!SplitFields(packed, &fields) || fields.size() % 2 != 0) return false;
+
+  materials->clear();
+  for (size_t i = 0; i < fields.size(); i += 2)
+    materials->push_back({fields[i], fields[i + 1]});
+  return true;
+}
+
+/**
+ * @brief PackLods Concatenates the faces and submeshes of the levels of
+ * detail.
+ */
+void PackLods(const std::vector<MeshLod> &lods, std::vector<CacheLod> *records,
+              std::vector<int> *faces, std::vector<Submesh> *submeshes) {
+  for (const auto &lod : lods) {
+    records->push_back({static_cast<uint32_t>(lod.faces.size()),
+                        static_cast<uint32_t>(lod.submeshes.size()), lod.error,
+                        0});
+    faces->insert(faces->end(), lod.faces.begin(), lod.faces.end());
+    submeshes->insert(submeshes->end(), lod.submeshes.begin(),
+                      lod.submeshes.end());
+  }
+}
+
+bool UnpackLods(const std::vector<CacheLod> &records,
+                const std::vector<int> &faces,
+                const std::vector<Submesh> &submeshes,
+                std::vector<MeshLod> *lods) {
+  size_t face = 0, submesh = 0;
+  lods->clear();
+  for (const auto &record : records) {
+    if (record.face_count > faces.size() - face ||
+        record.submesh_count > submeshes.size() - submesh)
+      return false;
+    MeshLod lod;
+    lod.faces.assign(faces.begin() + face,
+                     faces.begin() + face + record.face_count);
+    lod.submeshes.assign(submeshes.begin() + submesh,
+                         submeshes.begin() + submesh + record.submesh_count);
+    lod.error = record.error;
+    lods->push_back(lod);
+    face += record.face_count;
+    submesh += record.submesh_count;
+  }
+  return face == faces.size() && submesh == submeshes.size();
+}
+
+/**
+ * @brief PackStreams Serializes the descriptions of the vertex streams and
+ * their null-terminated names. The data is written as it is.
+ */
+void PackStreams(const std::vector<VertexStream> &streams,
+                 std::vector<CacheStream> *records, std::string *names) {
+  for (const auto &stream : streams) {
+    records->push_back({static_cast<uint32_t>(stream.type), stream.components,
+                        stream.stride, 0, stream.offset, stream.scale});
+    names->append(stream.name).push_back('\0');
+  }
+}
+
+bool UnpackStreams(const std::vector<CacheStream> &records,
+                   const std::string &names,
+                   std::vector<std::vector<uint8_t>> *data, size_t vertices,
+                   std::vector<VertexStream> *streams) {
+  std::vector<std::string> fields;
+  if (!SplitFields(names, &fields) || fields.size() != records.size() ||
+      data->size() != records.size())
+    return false;
+
+  streams->clear();
+  for (size_t i = 0; i < records.size(); ++i) {
+    const CacheStream &kRecord = records[i];
+    if (kRecord.type > static_cast<uint32_t>(ComponentType::kSnorm2101010))
+      return false;
+    VertexStream stream;
+    stream.name = fields[i];
+    stream.type = static_cast<ComponentType>(kRecord.type);
+    stream.components = kRecord.components;
+    stream.stride = kRecord.stride;
+    stream.offset = kRecord.offset;
+    stream.scale = kRecord.scale;
+    if (stream.stride != ComponentBytes(stream.type, stream.components) ||
+        (*data)[i].size() != vertices * stream.stride)
+      return false;
+    stream.data.swap((*data)[i]);
+    streams->push_back(std::move(stream));
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ReadSourceKey(const std::string &filename, SourceKey *key) {
+  return SourceStatus(filename, &key->size, &key->mtime) &&
+         HashFile(filename, &key->hash);
+}
+
+bool SourceUnchanged(const std::string &filename, const SourceKey &key) {
+  uint64_t size;
+  int64_t mtime;
+  if (!SourceStatus(filename, &size, &mtime) || size != key.size)
+    return false;
+  uint64_t hash;
+  return mtime == key.mtime || (HashFile(filename, &hash) && hash == key.hash);
+}
+
+std::string CachePath(const std::string &filename,
+                      const std::string &cache_dir) {
+  if (cache_dir.empty()) return filename + ".meshcache";
+
+  const size_t kSlash = filename.find_last_of("/\\");
+  const std::string kName =
+      kSlash == std::string::npos ? filename : filename.substr(kSlash + 1);
+
+  std::ostringstream path;
+  path << cache_dir << "/" << kName << "." << std::hex << std::setw(16)
+       << std::setfill('0') << HashBytes(filename.data(), filename.size())
+       << ".meshcache";
+  return path.str();
+}
+
+bool ReadFromCache(const std::string &filename, const std::string &cache_dir,
+                   uint32_t post_process, TriangleMesh *mesh) {
+  MappedFile file;
+  if (!file.Open(CachePath(filename, cache_dir))) return false;
+
+  CacheHeader header;
+  if (file.size() < sizeof(header)) return false;
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.post_process != post_process)
+    return false;
+
+  if ((file.size() - sizeof(header)) / sizeof(CacheSection) < header.sections)
+    return false;
+  std::vector<CacheSection> sections(header.sections);
+  memcpy(sections.data(), file.data() + sizeof(header),
+         sizeof(CacheSection) * sections.size());
+
+  std::string source_path;
+  for (const auto &section : sections)
+    if (section.tag == kSourcePath &&
+        !CopySection(file, section, &source_path))
+      return false;
+
+  // A touched but unchanged source keeps its cache.
+  SourceKey key;
+  key.size = header.source_size;
+  key.mtime = header.source_mtime;
+  key.hash = header.source_hash;
+  if (source_path != filename || !SourceUnchanged(filename, key)) return false;
+
+  mesh->Clear();
+  std::string diffuse_map, materials;
+  std::vector<CacheLod> lods;
+  std::vector<int> lod_faces;
+  std::vector<Submesh> lod_submeshes;
+  std::vector<CacheStream> streams;
+  std::string stream_names;
+  std::vector<std::vector<uint8_t>> stream_data;
+  bool res = true;
+  for (const auto &section : sections) {
+    switch (section.tag) {
+      case kVertices:
+        res = res && CopySection(file, section, &mesh->vertices_);
+        break;
+      case kFaces:
+        res = res && CopySection(file, section, &mesh->faces_);
+        break;
+      case kNormals:
+        res = res && CopySection(file, section, &mesh->normals_);
+        break;
+      case kTexCoords:
+        res = res && CopySection(file, section, &mesh->texCoords_);
+        break;
+      case kDiffuseMap:
+        res = res && CopySection(file, section, &diffuse_map);
+        break;
+      case kSubmeshes:
+        res = res && CopySection(file, section, &mesh->submeshes_);
+        break;
+      case kMaterials:
+        res = res && CopySection(file, section, &materials);
+        break;
+      case kLodFaces:
+        res = res && CopySection(file, section, &lod_faces);
+        break;
+      case kLods:
+        res = res && CopySection(file, section, &lods);
+        break;
+      case kLodSubmeshes:
+        res = res && CopySection(file, section, &lod_submeshes);
+        break;
+      case kMeshlets:
+        res = res && CopySection(file, section, &mesh->meshlets_);
+        break;
+      case kStreams:
+        res = res && CopySection(file, section, &streams);
+        break;
+      case kStreamNames:
+        res = res && CopySection(file, section, &stream_names);
+        break;
+      case kStreamData:
+        stream_data.emplace_back();
+        res = res && CopySection(file, section, &stream_data.back());
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (!res || !UnpackMaterials(materials, &mesh->materials_) ||
+      !UnpackLods(lods, lod_faces, lod_submeshes, &mesh->lods_) ||
+      !UnpackStreams(streams, stream_names, &stream_data,
+                     mesh->vertices_.size() / 3, &mesh->streams_)) {
+    mesh->Clear();
+    return false;
+  }
+
+  mesh->diffuseMap_ = diffuse_map;
+  mesh->min_ = glm::vec3(header.min[0], header.min[1], header.min[2]);
+  mesh->max_ = glm::vec3(header.max[0], header.max[1], header.max[2]);
+  return true;
+}
+
+bool WriteToCache(const std::string &filename, const std::string &cache_dir,
+                  uint32_t post_process, const TriangleMesh &mesh) {
+  CacheHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.post_process = post_process;
+  header.reserved = 0;
+  SourceKey key;
+  if (!ReadSourceKey(filename, &key)) return false;
+  header.source_size = key.size;
+  header.source_mtime = key.mtime;
+  header.source_hash = key.hash;
+  for (int i = 0; i < 3; ++i) {
+    header.min[i] = mesh.min_[i];
+    header.max[i] = mesh.max_[i];
+  }
+
+  const std::string kPackedMaterials = PackMaterials(mesh.materials_);
+  std::vector<CacheLod> lods;
+  std::vector<int> lod_faces;
+  std::vector<Submesh> lod_submeshes;
+  PackLods(mesh.lods_, &lods, &lod_faces, &lod_submeshes);
+  std::vector<CacheStream> streams;
+  std::string stream_names;
+  PackStreams(mesh.streams_, &streams, &stream_names);
+  std::vector<CacheBlob> blobs = {
+      {kSourcePath, filename.data(), filename.size()},
+      {kVertices, mesh.vertices_.data(), sizeof(float) * mesh.vertices_.size()},
+      {kFaces, mesh.faces_.data(), sizeof(int) * mesh.faces_.size()},
+      {kNormals, mesh.normals_.data(), sizeof(float) * mesh.normals_.size()},
+      {kTexCoords, mesh.texCoords_.data(),
+       sizeof(float) * mesh.texCoords_.size()},
+      {kDiffuseMap, mesh.diffuseMap_.data(), mesh.diffuseMap_.size()},
+      {kSubmeshes, mesh.submeshes_.data(),
+       sizeof(Submesh) * mesh.submeshes_.size()},
+      {kMaterials, kPackedMaterials.data(), kPackedMaterials.size()},
+      {kLodFaces, lod_faces.data(), sizeof(int) * lod_faces.size()},
+      {kLods, lods.data(), sizeof(CacheLod) * lods.size()},
+      {kLodSubmeshes, lod_submeshes.data(),
+       sizeof(Submesh) * lod_submeshes.size()},
+      {kMeshlets, mesh.meshlets_.data(),
+       sizeof(Meshlet) * mesh.meshlets_.size()},
+      {kStreams, streams.data(), sizeof(CacheStream) * streams.size()},
+      {kStreamNames, stream_names.data(), stream_names.size()}};
+  for (const auto &stream : mesh.streams_)
+    blobs.push_back({kStreamData, stream.data.data(), stream.data.size()});
+  header.sections = static_cast<uint32_t>(blobs.size());
+
+  std::vector<CacheSection> sections(blobs.size());
+  uint64_t offset = sizeof(header) + sizeof(CacheSection) * sections.size();
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    offset = AlignToPage(offset);
+    sections[i].tag = blobs[i].tag;
+    sections[i].reserved = 0;
+    sections[i].offset = offset;
+    sections[i].size = blobs[i].size;
+    offset += blobs[i].size;
+  }
+
+  // Written under a temporary name, unique per thread, so that readers never
+  // map a partial cache and concurrent writers do not interleave.
+  const std::string kPath = CachePath(filename, cache_dir);
+  std::ostringstream temporary;
+  temporary << kPath << "." << std::hex
+            << std::hash<std::thread::id>()(std::this_thread::get_id())
+            << ".tmp";
+  const std::string kTemporary = temporary.str();
+  std::ofstream fout(kTemporary.c_str(),
+                     std::ios_base::out | std::ios_base::binary);
+  if (!fout.is_open() || !fout.good()) return false;
+
+  fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  fout.write(reinterpret_cast<const char *>(sections.data()),
+             sizeof(CacheSection) * sections.size());
+  const std::vector<char> kPadding(kPageSize, 0);
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    const uint64_t kPosition = static_cast<uint64_t>(fout.tellp());
+    fout.write(kPadding.data(),
+               static_cast<std::streamsize>(sections[i].offset - kPosition));
+    if (blobs[i].size > 0)
+      fout.write(static_cast<const char *>(blobs[i].data),
+                 static_cast<std::streamsize>(blobs[i].size));
+  }
+  fout.close();
+
+  if (fout.fail()) {
+    std::remove(kTemporary.c_str());
+    return false;
+  }
+
+  std::remove(kPath.c_str());
+  return std::rename(kTemporary.c_str(), kPath.c_str()) == 0;
+}
+
+}  // namespace data_representation
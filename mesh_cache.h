@@ -0,0 +1,82 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef MESH_CACHE_H_
+#define MESH_CACHE_H_
+
+#include <triangle_mesh.h>
+
+#include <cstdint>
+#include <string>
+
+namespace data_representation {
+
+/**
+ * @brief The SourceKey struct Identifies the content of a source mesh file,
+ * the same way the header of its cache does.
+ */
+struct SourceKey {
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  uint64_t hash = 0;
+};
+
+/**
+ * @brief ReadSourceKey Reads the size and modification time of a file and
+ * hashes its content.
+ * @param filename The path to the source mesh.
+ * @param key The resulting key.
+ * @return Whether the file could be read.
+ */
+bool ReadSourceKey(const std::string &filename, SourceKey *key);
+
+/**
+ * @brief SourceUnchanged Checks whether a file still matches a key: it must
+ * have the same size, and the same modification time or content hash. The
+ * file is only hashed if its modification time differs.
+ * @param filename The path to the source mesh.
+ * @param key The key read when the mesh was loaded.
+ * @return Whether the file has the same content.
+ */
+bool SourceUnchanged(const std::string &filename, const SourceKey &key);
+
+/**
+ * @brief CachePath Path of the binary cache of the mesh at filename.
+ * @param filename The path to the source mesh.
+ * @param cache_dir Directory holding the caches. If empty, the cache is
+ * stored next to the source as filename.meshcache.
+ * @return The path to the cache file.
+ */
+std::string CachePath(const std::string &filename,
+                      const std::string &cache_dir);
+
+/**
+ * @brief ReadFromCache Loads the mesh from its binary cache. The cache is
+ * only used if it was generated from the same path and the source still has
+ * the same size and modification time, or the same content hash, and with
+ * the same post-processing.
+ * @param filename The path to the source mesh.
+ * @param cache_dir Directory holding the caches, see CachePath.
+ * @param post_process Bit mask of the passes applied after parsing.
+ * @param mesh The resulting representation, including normals, texture
+ * coordinates, levels of detail, meshlets, vertex streams such as the baked
+ * occlusion, and bounding box.
+ * @return Whether a valid cache was found.
+ */
+bool ReadFromCache(const std::string &filename, const std::string &cache_dir,
+                   uint32_t post_process, TriangleMesh *mesh);
+
+/**
+ * @brief WriteToCache Stores the mesh loaded from filename in a versioned
+ * binary cache with page-aligned arrays.
+ * @param filename The path to the source mesh.
+ * @param cache_dir Directory holding the caches, see CachePath.
+ * @param post_process Bit mask of the passes applied after parsing.
+ * @param mesh The mesh to be stored.
+ * @return Whether it was able to store the cache.
+ */
+bool WriteToCache(const std::string &filename, const std::string &cache_dir,
+                  uint32_t post_process, const TriangleMesh &mesh);
+
+}  // namespace data_representation
+
+#endif  // MESH_CACHE_H_
@@ -0,0 +1,485 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <mesh_cleanup.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "./parallel.h"
+#include "./radix_sort.h"
+
+namespace data_representation {
+
+namespace {
+
+const size_t kMinGrain = 1 << 14;
+
+/**
+ * @brief kCellSize Edge of the cells of the welding hash, in units of the
+ * welding distance. Larger cells make it less likely that a vertex is close
+ * enough to their boundary to be inserted in the neighbouring ones too, at
+ * the cost of more vertices per cell.
+ */
+const double kCellSize = 16.0;
+
+/**
+ * @brief Mix 64-bit finalizer of SplitMix64.
+ */
+uint64_t Mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+/**
+ * @brief Hash3 Spreads three cell coordinates or indices over 32 bits, the
+ * highest ones being the best mixed.
+ */
+uint32_t Hash3(uint64_t x, uint64_t y, uint64_t z) {
+  return static_cast<uint32_t>(Mix(x * 0x9e3779b97f4a7c15ull ^
+                                   y * 0xc2b2ae3d27d4eb4full ^ z) >> 32);
+}
+
+/**
+ * @brief KeyBits Bits of the keys for about n entries, enough that unrelated
+ * entries rarely share a key, rounded up to whole bytes. A shared key only
+ * costs a comparison, since the runs compare the entries themselves.
+ */
+int KeyBits(size_t n) {
+  int bits = 8;
+  while (bits < 32 && (static_cast<uint64_t>(1) << bits) < n * 4) bits += 8;
+  return bits;
+}
+
+/**
+ * @brief The WeldEntry struct A vertex in one of the cells it may weld in.
+ * The position travels with it, so that the cells are compared without
+ * touching the vertex arrays.
+ */
+struct WeldEntry {
+  uint32_t key;
+  uint32_t vertex;
+  glm::vec3 position;
+};
+
+/**
+ * @brief The TriangleEntry struct A triangle, keyed by its vertices and range.
+ */
+struct TriangleEntry {
+  uint32_t key;
+  uint32_t triangle;
+  uint32_t range;
+};
+
+/**
+ * @brief kMaxEntries Most entries emitted for a single element, a vertex in
+ * all 8 cells around a cell corner.
+ */
+const size_t kMaxEntries = 8;
+
+/**
+ * @brief SortedEntries The entries emitted for every element, sorted by the
+ * lowest bits of their key, and in the order of the elements within a key.
+ * emit(i, out) writes at most kMaxEntries entries for element i to out and
+ * returns how many. Sorts like RadixSort, except that the entries are
+ * emitted twice, first to count them by the top byte of their key, and then
+ * straight into their bucket, so that no unsorted copy of them is made.
+ * @param n The number of elements.
+ * @param bits The bits of the key to sort by, a multiple of 8.
+ * @param emit The entries of an element.
+ */
+template <typename T, typename F>
+std::vector<T> SortedEntries(size_t n, int bits, const F &emit) {
+  const int kShift = bits - 8;
+  const size_t kChunks = NumChunks(n, kMinGrain);
+  std::vector<std::vector<size_t>> offsets(kChunks, std::vector<size_t>(256));
+  ParallelForChunks(n, kChunks, [&](size_t c, size_t begin, size_t end) {
+    T out[kMaxEntries];
+    for (size_t i = begin; i < end; ++i) {
+      const size_t kEmitted = emit(i, out);
+      for (size_t k = 0; k < kEmitted; ++k)
+        ++offsets[c][(out[k].key >> kShift) & 0xFF];
+    }
+  });
+
+  std::vector<size_t> buckets(257, 0);
+  size_t offset = 0;
+  for (size_t digit = 0; digit < 256; ++digit) {
+    buckets[digit] = offset;
+    for (size_t c = 0; c < kChunks; ++c) {
+      const size_t kCount = offsets[c][digit];
+      offsets[c][digit] = offset;
+      offset += kCount;
+    }
+  }
+  buckets[256] = offset;
+
+  std::vector<T> entries(offset);
+  ParallelForChunks(n, kChunks, [&](size_t c, size_t begin, size_t end) {
+    T out[kMaxEntries];
+    for (size_t i = begin; i < end; ++i) {
+      const size_t kEmitted = emit(i, out);
+      for (size_t k = 0; k < kEmitted; ++k)
+        entries[offsets[c][(out[k].key >> kShift) & 0xFF]++] = out[k];
+    }
+  });
+
+  ParallelFor(256, 1, [&](size_t begin, size_t end) {
+    std::vector<T> scratch;
+    for (size_t digit = begin; digit < end; ++digit)
+      RadixSortRange(entries.data() + buckets[digit],
+                     entries.data() + buckets[digit + 1], kShift, &scratch);
+  });
+  return entries;
+}
+
+/**
+ * @brief ForEachRun Calls f(first, last) in parallel for every run of two or
+ * more sorted entries with the same key. Every chunk handles the runs that
+ * start inside it.
+ */
+template <typename T, typename F>
+void ForEachRun(const std::vector<T> &entries, const F &f) {
+  ParallelFor(entries.size(), kMinGrain, [&](size_t begin, size_t end) {
+    while (begin > 0 && begin < end &&
+           entries[begin].key == entries[begin - 1].key)
+      ++begin;
+    for (size_t first = begin; first < end;) {
+      size_t last = first + 1;
+      while (last < entries.size() && entries[last].key == entries[first].key)
+        ++last;
+      if (last - first > 1) f(first, last);
+      first = last;
+    }
+  });
+}
+
+/**
+ * @brief SameValues Whether two vertices have the same values of an
+ * attribute, trivially if the mesh does not have it.
+ */
+bool SameValues(const std::vector<float> &values, size_t components,
+                size_t vertices, size_t a, size_t b) {
+  if (values.size() != vertices * components) return true;
+  return memcmp(&values[a * components], &values[b * components],
+                sizeof(float) * components) == 0;
+}
+
+/**
+ * @brief WeldVertices Maps every vertex to the vertex it is welded into,
+ * itself if none, see CleanMesh. Every vertex is inserted in its cell, and
+ * in the neighbouring cells it is closer to than the distance, so any two
+ * vertices within the distance share the cell of one of them. The entries
+ * are sorted by cell, and only entries of the same cell are compared.
+ * @param mesh The mesh.
+ * @param distance The absolute welding distance, or 0 to weld only identical
+ * positions.
+ */
+std::vector<int> WeldVertices(const TriangleMesh &mesh, float distance) {
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  const bool kExact = !(distance > 0.0f);
+  const double kInverseCell = 1.0 / (kCellSize * distance);
+  const double kBoundary = 1.0 / kCellSize;
+  const int kKeyBits = KeyBits(kVertices * 2);
+
+  const std::vector<WeldEntry> kEntries = SortedEntries<WeldEntry>(
+      kVertices, kKeyBits, [&](size_t v, WeldEntry *out) -> size_t {
+        const float *kPosition = &mesh.vertices_[v * 3];
+        WeldEntry entry = {0, static_cast<uint32_t>(v),
+                           glm::vec3(kPosition[0], kPosition[1],
+                                     kPosition[2])};
+        if (kExact) {
+          uint32_t bits[3];
+          memcpy(bits, kPosition, sizeof(bits));
+          entry.key = Hash3(bits[0], bits[1], bits[2]) >> (32 - kKeyBits);
+          out[0] = entry;
+          return 1;
+        }
+
+        int64_t base[3], step[3];
+        for (int j = 0; j < 3; ++j) {
+          const double kScaled = kPosition[j] * kInverseCell;
+          base[j] = static_cast<int64_t>(std::floor(kScaled));
+          const double kOffset = kScaled - base[j];
+          step[j] = kOffset < kBoundary ? -1 : (1.0 - kOffset < kBoundary);
+        }
+        size_t emitted = 0;
+        for (int corner = 0; corner < 8; ++corner) {
+          if (((corner & 1) && !step[0]) || ((corner & 2) && !step[1]) ||
+              ((corner & 4) && !step[2]))
+            continue;
+          entry.key = Hash3(base[0] + (corner & 1 ? step[0] : 0),
+                            base[1] + (corner & 2 ? step[1] : 0),
+                            base[2] + (corner & 4 ? step[2] : 0)) >>
+                      (32 - kKeyBits);
+          out[emitted++] = entry;
+        }
+        return emitted;
+      });
+
+  std::unique_ptr<std::atomic<uint32_t>[]> targets(
+      new std::atomic<uint32_t>[kVertices]);
+  ParallelFor(kVertices, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v)
+      targets[v].store(static_cast<uint32_t>(v), std::memory_order_relaxed);
+  });
+
+  // Entries of a run keep the vertex order, so the first match is the lowest
+  // vertex of the cell. A vertex may find matches in several cells.
+  const float kSquaredDistance = distance * distance;
+  ForEachRun(kEntries, [&](size_t first, size_t last) {
+    for (size_t j = first + 1; j < last; ++j) {
+      const WeldEntry &kEntry = kEntries[j];
+      for (size_t i = first; i < j; ++i) {
+        const WeldEntry &kOther = kEntries[i];
+        if (kOther.vertex == kEntry.vertex) continue;
+        const glm::vec3 kDelta = kOther.position - kEntry.position;
+        const bool kClose = kExact ? kDelta == glm::vec3(0.0f)
+                                   : glm::dot(kDelta, kDelta) <=
+                                         kSquaredDistance;
+        if (!kClose ||
+            !SameValues(mesh.normals_, 3, kVertices, kOther.vertex,
+                        kEntry.vertex) ||
+            !SameValues(mesh.texCoords_, 2, kVertices, kOther.vertex,
+                        kEntry.vertex) ||
+            !SameStreamValues(mesh.streams_, kOther.vertex, kEntry.vertex))
+          continue;
+        std::atomic<uint32_t> &target = targets[kEntry.vertex];
+        uint32_t current = target.load(std::memory_order_relaxed);
+        while (kOther.vertex < current &&
+               !target.compare_exchange_weak(current, kOther.vertex,
+                                             std::memory_order_relaxed)) {
+        }
+        break;
+      }
+    }
+  });
+
+  // Targets have lower indices, so they are final by the time they are read.
+  std::vector<int> remap(kVertices);
+  for (size_t v = 0; v < kVertices; ++v) {
+    const uint32_t kTarget = targets[v].load(std::memory_order_relaxed);
+    remap[v] = kTarget == v ? static_cast<int>(v) : remap[kTarget];
+  }
+  return remap;
+}
+
+/**
+ * @brief CanonicalTriangle The vertices of a triangle rotated so that the
+ * lowest index comes first, which keeps the winding.
+ */
+void CanonicalTriangle(const int *face, int canonical[3]) {
+  const int kFirst = face[0] < face[1] ? (face[0] < face[2] ? 0 : 2)
+                                       : (face[1] < face[2] ? 1 : 2);
+  for (int k = 0; k < 3; ++k) canonical[k] = face[(kFirst + k) % 3];
+}
+
+/**
+ * @brief FilterTriangles Removes the degenerate triangles and the duplicated
+ * ones within every range, keeping the order of the rest, and shrinks the
+ * submesh ranges. Duplicates are found like welded vertices, sorting the
+ * triangles by a hash of their vertices.
+ * @param vertices The positions of the mesh.
+ * @param min_cross Largest length of the cross product of two edges, twice
+ * the area, of a degenerate triangle.
+ * @param faces Three vertex indices per triangle.
+ * @param submeshes The ranges of faces, or empty for a single range.
+ * @param degenerate Incremented by the number of degenerate triangles.
+ * @param duplicate Incremented by the number of duplicated triangles.
+ */
+void FilterTriangles(const std::vector<float> &vertices, float min_cross,
+                     std::vector<int> *faces, std::vector<Submesh> *submeshes,
+                     size_t *degenerate, size_t *duplicate) {
+  const size_t kTriangles = faces->size() / 3;
+  const int *kFaces = faces->data();
+
+  std::vector<size_t> range_ends;
+  for (const auto &submesh : *submeshes)
+    range_ends.push_back((submesh.first + submesh.count) / 3);
+  if (submeshes->empty()) range_ends.push_back(kTriangles);
+
+  std::vector<char> degenerates(kTriangles);
+  ParallelFor(kTriangles, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      const int *kFace = kFaces + t * 3;
+      const glm::vec3 kA(vertices[kFace[0] * 3], vertices[kFace[0] * 3 + 1],
+                         vertices[kFace[0] * 3 + 2]);
+      const glm::vec3 kB(vertices[kFace[1] * 3], vertices[kFace[1] * 3 + 1],
+                         vertices[kFace[1] * 3 + 2]);
+      const glm::vec3 kC(vertices[kFace[2] * 3], vertices[kFace[2] * 3 + 1],
+                         vertices[kFace[2] * 3 + 2]);
+      const float kCross = glm::length(glm::cross(kB - kA, kC - kA));
+      degenerates[t] = kFace[0] == kFace[1] || kFace[1] == kFace[2] ||
+                       kFace[2] == kFace[0] || !(kCross > min_cross);
+    }
+  });
+
+  // Duplicates are only looked for within the same range, so that every
+  // submesh keeps its own copy.
+  const int kKeyBits = KeyBits(kTriangles);
+  const std::vector<TriangleEntry> kEntries = SortedEntries<TriangleEntry>(
+      kTriangles, kKeyBits, [&](size_t t, TriangleEntry *out) -> size_t {
+        if (degenerates[t]) return 0;
+        const uint32_t kRange = static_cast<uint32_t>(
+            std::upper_bound(range_ends.begin(), range_ends.end(), t) -
+            range_ends.begin());
+        int canonical[3];
+        CanonicalTriangle(kFaces + t * 3, canonical);
+        const uint32_t kKey =
+            Hash3(canonical[0], canonical[1],
+                  static_cast<uint64_t>(canonical[2]) << 32 | kRange) >>
+            (32 - kKeyBits);
+        out[0] = {kKey, static_cast<uint32_t>(t), kRange};
+        return 1;
+      });
+
+  std::vector<char> duplicates(kTriangles, 0);
+  ForEachRun(kEntries, [&](size_t first, size_t last) {
+    for (size_t j = first + 1; j < last; ++j) {
+      int canonical[3];
+      CanonicalTriangle(kFaces + kEntries[j].triangle * 3, canonical);
+      for (size_t i = first; i < j; ++i) {
+        int other[3];
+        CanonicalTriangle(kFaces + kEntries[i].triangle * 3, other);
+        if (kEntries[i].range == kEntries[j].range &&
+            std::equal(canonical, canonical + 3, other)) {
+          duplicates[kEntries[j].triangle] = 1;
+          break;
+        }
+      }
+    }
+  });
+
+  size_t next = 0, first = 0;
+  for (size_t r = 0; r < range_ends.size(); ++r) {
+    const size_t kFirst = next;
+    for (size_t t = first; t < range_ends[r]; ++t) {
+      if (degenerates[t]) {
+        ++*degenerate;
+      } else if (duplicates[t]) {
+        ++*duplicate;
+      } else {
+        std::copy(faces->begin() + t * 3, faces->begin() + t * 3 + 3,
+                  faces->begin() + next * 3);
+        ++next;
+      }
+    }
+    first = range_ends[r];
+    if (!submeshes->empty()) {
+      (*submeshes)[r].first = static_cast<unsigned int>(kFirst * 3);
+      (*submeshes)[r].count = static_cast<unsigned int>((next - kFirst) * 3);
+    }
+  }
+  faces->resize(next * 3);
+}
+
+uint64_t CleanableBytes(const TriangleMesh &mesh) {
+  uint64_t bytes = sizeof(float) * (mesh.vertices_.size() +
+                                    mesh.normals_.size() +
+                                    mesh.texCoords_.size()) +
+                   sizeof(int) * mesh.faces_.size();
+  for (const auto &lod : mesh.lods_) bytes += sizeof(int) * lod.faces.size();
+  return bytes + VertexStreamBytes(mesh.streams_);
+}
+
+}  // namespace
+
+void CleanMesh(TriangleMesh *mesh, float epsilon, CleanupStats *stats) {
+  CleanupStats result = {0, 0, 0, 0, 0};
+  const size_t kVertices = mesh->vertices_.size() / 3;
+  const glm::vec3 kExtent = mesh->max_ - mesh->min_;
+  const float kScale = std::max(kExtent[0], std::max(kExtent[1], kExtent[2]));
+  if (kVertices == 0 || !(kScale >= 0.0f)) {
+    if (stats != nullptr) *stats = result;
+    return;
+  }
+  // Welding compares the stream records of every vertex.
+  DropMismatchedStreams(kVertices, &mesh->streams_);
+  const uint64_t kBytesBefore = CleanableBytes(*mesh);
+  const float kDistance = epsilon * kScale;
+
+  const std::vector<int> kWelded = WeldVertices(*mesh, kDistance);
+  for (size_t v = 0; v < kVertices; ++v)
+    if (kWelded[v] != static_cast<int>(v)) ++result.welded_vertices;
+
+  auto weld = [&](std::vector<int> *faces) {
+    ParallelFor(faces->size(), kMinGrain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) (*faces)[i] = kWelded[(*faces)[i]];
+    });
+  };
+  const float kMinCross = kDistance * kDistance;
+  weld(&mesh->faces_);
+  FilterTriangles(mesh->vertices_, kMinCross, &mesh->faces_,
+                  &mesh->submeshes_, &result.degenerate_triangles,
+                  &result.duplicate_triangles);
+  for (auto &lod : mesh->lods_) {
+    weld(&lod.faces);
+    FilterTriangles(mesh->vertices_, kMinCross, &lod.faces, &lod.submeshes,
+                    &result.degenerate_triangles, &result.duplicate_triangles);
+  }
+
+  std::unique_ptr<std::atomic<char>[]> used(new std::atomic<char>[kVertices]);
+  ParallelFor(kVertices, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v)
+      used[v].store(0, std::memory_order_relaxed);
+  });
+  auto mark = [&](const std::vector<int> &faces) {
+    ParallelFor(faces.size(), kMinGrain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        used[faces[i]].store(1, std::memory_order_relaxed);
+    });
+  };
+  mark(mesh->faces_);
+  for (const auto &lod : mesh->lods_) mark(lod.faces);
+
+  std::vector<int> compact(kVertices, -1);
+  size_t kept = 0;
+  for (size_t v = 0; v < kVertices; ++v)
+    if (used[v].load(std::memory_order_relaxed))
+      compact[v] = static_cast<int>(kept++);
+  result.unused_vertices = kVertices - kept - result.welded_vertices;
+
+  auto renumber = [&](std::vector<int> *faces) {
+    ParallelFor(faces->size(), kMinGrain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        (*faces)[i] = compact[(*faces)[i]];
+    });
+  };
+  renumber(&mesh->faces_);
+  for (auto &lod : mesh->lods_) renumber(&lod.faces);
+
+  auto shrink = [&](size_t components, std::vector<float> *values) {
+    if (values->size() != kVertices * components) return;
+    std::vector<float> kept_values(kept * components);
+    ParallelFor(kVertices, kMinGrain, [&](size_t begin, size_t end) {
+      for (size_t v = begin; v < end; ++v)
+        if (compact[v] >= 0)
+          std::copy(values->begin() + v * components,
+                    values->begin() + (v + 1) * components,
+                    kept_values.begin() + compact[v] * components);
+    });
+    values->swap(kept_values);
+  };
+  shrink(3, &mesh->vertices_);
+  shrink(3, &mesh->normals_);
+  shrink(2, &mesh->texCoords_);
+  PermuteVertexStreams(compact, kept, &mesh->streams_);
+
+  mesh->meshlets_.clear();
+  mesh->InvalidateAdjacency();
+
+  result.bytes_saved = kBytesBefore - CleanableBytes(*mesh);
+  if (stats != nullptr) *stats = result;
+}
+
+}  // namespace data_representation
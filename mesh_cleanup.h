@@ -0,0 +1,82 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef MESH_CLEANUP_H_
+#define MESH_CLEANUP_H_
+
+#include <triangle_mesh.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace data_representation {
+
+/**
+ * @brief kWeldEpsilon Default distance below which vertices are welded,
+ * relative to the longest edge of the bounding box.
+ */
+const float kWeldEpsilon = 1e-6f;
+
+/**
+ * @brief The CleanupStats struct What CleanMesh removed.
+ */
+struct CleanupStats {
+  /**
+   * @brief welded_vertices Vertices merged into an earlier one.
+   */
+  size_t welded_vertices;
+
+  /**
+   * @brief unused_vertices Vertices removed because no face references them,
+   * not counting the welded ones.
+   */
+  size_t unused_vertices;
+
+  /**
+   * @brief degenerate_triangles Triangles removed because two of their
+   * corners are the same vertex or their area is below the epsilon, from
+   * faces_ and the levels of detail.
+   */
+  size_t degenerate_triangles;
+
+  /**
+   * @brief duplicate_triangles Triangles removed because an earlier triangle
+   * of the same submesh has the same vertices and winding, from faces_ and
+   * the levels of detail.
+   */
+  size_t duplicate_triangles;
+
+  /**
+   * @brief bytes_saved Memory released from the vertex attributes and the
+   * faces of the mesh and its levels of detail.
+   */
+  uint64_t bytes_saved;
+};
+
+/**
+ * @brief CleanMesh Removes redundant data from the mesh, in parallel:
+ * 1. Welds the vertices closer than epsilon that have the same normals,
+ *    texture coordinates, occlusion and streams, if the mesh has them, into
+ *    the one with the lowest index. Vertices are radix sorted by a hash of
+ *    the cells of a spatial grid they are within epsilon of, so the
+ *    candidates of a vertex are the contiguous entries that share a cell with
+ *    it. Welding is transitive, so a chain of close vertices collapses into
+ *    its first one.
+ * 2. Removes the degenerate triangles, and the duplicated ones within every
+ *    submesh, found the same way by sorting a hash of their vertices, from
+ *    faces_ and the levels of detail. Submesh ranges shrink accordingly.
+ * 3. Compacts the vertices that are still referenced, keeping their order,
+ *    and renumbers the faces.
+ * Drops the meshlets and invalidates the adjacency of the mesh. The bounding
+ * boxes are left as they are, which still encloses the result.
+ * @param mesh The mesh, with its bounding box.
+ * @param epsilon The welding distance, relative to the longest edge of the
+ * bounding box. With 0 only identical positions are welded, and only
+ * triangles with exactly zero area are removed.
+ * @param stats If not null, receives what was removed.
+ */
+void CleanMesh(TriangleMesh *mesh, float epsilon = kWeldEpsilon,
+               CleanupStats *stats = nullptr);
+
+}  // namespace data_representation
+
+#endif  // MESH_CLEANUP_H_
@@ -6,17 +6,26 @@
 
 #include <algorithm>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <string>
 #include <vector>
 #include <cstring>
 
 #include <math.h>
 
+#include "./mapped_file.h"
+#include "./obj_parser.h"
+#include "./parallel.h"
+#include "./ply_schema.h"
 #include "./triangle_mesh.h"
 #include "./tiny_obj_loader.h"
+#include "./vertex_attributes.h"
 
 #include <glm/vec3.hpp>
+#include <glm/common.hpp>
 #include <glm/geometric.hpp>
 
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -25,296 +34,361 @@ namespace data_representation {
 
 namespace {
 
-template <typename T>
-void Add3Items(T i1, T i2, T i3, size_t index, std::vector<T> *vector) {
-  (*vector)[index] = i1;
-  (*vector)[index + 1] = i2;
-  (*vector)[index + 2] = i3;
-}
-
-bool ReadPlyHeader(std::ifstream *fin, int *vertices, int *faces) {
-  char line[100];
-
-  fin->getline(line, 100);
-  if (strncmp(line, "ply", 3) != 0) return false;
-
-  *vertices = 0;
-  fin->getline(line, 100);
-  while (strncmp(line, "end_header", 10) != 0) {
-    if (strncmp(line, "element vertex", 14) == 0) *vertices = atoi(&line[15]);
-    fin->getline(line, 100);
-    if (strncmp(line, "element face", 12) == 0) *faces = atoi(&line[13]);
-    if (strncmp(line, "property float n", 16) == 0) hasNormals = true;
+/**
+ * @brief WriteRecords Writes count fixed-size records to fout. Records are
+ * encoded by encode(index, destination) in parallel into large buffers, and
+ * each buffer is written while the next one is being encoded.
+ */
+template <typename F>
+bool WriteRecords(std::ofstream *fout, size_t count, size_t stride,
+                  const F &encode) {
+  const size_t kBufferSize = 32 << 20;
+  const size_t kRecordsPerBuffer = std::max<size_t>(1, kBufferSize / stride);
+
+  std::vector<char> buffers[2];
+  std::future<void> pending;
+  int current = 0;
+  for (size_t first = 0; first < count; first += kRecordsPerBuffer) {
+    const size_t kRecords = std::min(kRecordsPerBuffer, count - first);
+    std::vector<char> *buffer = &buffers[current];
+    buffer->resize(kRecords * stride);
+
+    ParallelFor(kRecords, 1 << 14, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        encode(first + i, buffer->data() + i * stride);
+    });
+
+    if (pending.valid()) pending.get();
+    pending = std::async(std::launch::async, [fout, buffer]() {
+      fout->write(buffer->data(), static_cast<std::streamsize>(buffer->size()));
+    });
+    current = 1 - current;
   }
+  if (pending.valid()) pending.get();
 
-  if (*vertices <= 0) return false;
-
-  std::cout << "Loading triangle mesh" << std::endl;
-  std::cout << "\tVertices = " << *vertices << std::endl;
-  std::cout << "\tFaces = " << *faces << std::endl;
-
-  return true;
+  return fout->good();
 }
 
-void ReadPlyVertices(std::ifstream *fin, TriangleMesh *mesh) {
-  const size_t kVertices = mesh->vertices_.size() / 3;
-  for (size_t i = 0; i < kVertices; ++i) {
-    float x, y, z;
-    fin->read(reinterpret_cast<char *>(&x), sizeof(float));
-    fin->read(reinterpret_cast<char *>(&y), sizeof(float));
-    fin->read(reinterpret_cast<char *>(&z), sizeof(float));
-
-    Add3Items(x, y, z, i * 3, &(mesh->vertices_));
-    if(hasNormals) {
-        fin->read(reinterpret_cast<char *>(&x), sizeof(float));
-        fin->read(reinterpret_cast<char *>(&y), sizeof(float));
-        fin->read(reinterpret_cast<char *>(&z), sizeof(float));
-
-        Add3Items(x, y, z, i * 3, &(mesh->normals_));
+std::vector<tinyobj::material_t> ReadObjMaterials(
+    const std::string &base_dir, const std::vector<std::string> &libraries,
+    std::map<std::string, int> *material_map) {
+  std::vector<tinyobj::material_t> materials;
+
+  for (const auto &library : libraries) {
+    std::ifstream fin((base_dir + "/" + library).c_str());
+    if (!fin.is_open() || !fin.good()) {
+      std::cerr << "Material library " << library << " not found."
+                << std::endl;
+      continue;
     }
-  }
-}
-
-void ReadPlyFaces(std::ifstream *fin, TriangleMesh *mesh) {
-  unsigned char vertex_per_face;
-
-  const size_t kFaces = mesh->faces_.size() / 3;
-  for (size_t i = 0; i < kFaces; ++i) {
-    int v1, v2, v3;
-    fin->read(reinterpret_cast<char *>(&vertex_per_face),
-              sizeof(unsigned char));
-    assert(vertex_per_face == 3);
 
-    fin->read(reinterpret_cast<char *>(&v1), sizeof(int));
-    fin->read(reinterpret_cast<char *>(&v2), sizeof(int));
-    fin->read(reinterpret_cast<char *>(&v3), sizeof(int));
-    Add3Items(v1, v2, v3, i * 3, &(mesh->faces_));
+    std::string warn, err;
+    tinyobj::LoadMtl(material_map, &materials, &fin, &warn, &err);
+    if (!warn.empty()) std::cout << warn << std::endl;
+    if (!err.empty()) std::cerr << err << std::endl;
   }
+
+  return materials;
 }
 
-void ComputeVertexNormals(const std::vector<float> &vertices,
-                          const std::vector<int> &faces,
-                          std::vector<float> *normals) {
-  const size_t kFaces = faces.size();
-  std::vector<float> face_normals(kFaces, 0);
-
-  for (size_t i = 0; i < kFaces; i += 3) {
-    glm::vec3 v1(vertices[faces[i] * 3], vertices[faces[i] * 3 + 1],
-                       vertices[faces[i] * 3 + 2]);
-    glm::vec3 v2(vertices[faces[i + 1] * 3],
-                       vertices[faces[i + 1] * 3 + 1],
-                       vertices[faces[i + 1] * 3 + 2]);
-    glm::vec3 v3(vertices[faces[i + 2] * 3],
-                       vertices[faces[i + 2] * 3 + 1],
-                       vertices[faces[i + 2] * 3 + 2]);
-    glm::vec3 v1v2 = v2 - v1;
-    glm::vec3 v1v3 = v3 - v1;
-    glm::vec3 normal = glm::cross(v1v2,v1v3);
-
-    if (glm::length(normal) < 0.00001) {
-      normal = glm::vec3(0.0, 0.0, 0.0);
-    } else {
-      glm::normalize(normal);
+/**
+ * @brief SortTrianglesByMaterial Stable parallel counting sort of the
+ * triangles by the material assigned by the usemtl statements, producing one
+ * submesh per used material.
+ */
+void SortTrianglesByMaterial(const std::vector<ObjMaterialUse> &uses,
+                             const std::map<std::string, int> &material_map,
+                             std::vector<ObjCorner> *corners,
+                             std::vector<Submesh> *submeshes) {
+  const size_t kTriangles = corners->size() / 3;
+  std::vector<int> materials(kTriangles, -1);
+  int max_material = -1;
+  for (size_t u = 0; u < uses.size(); ++u) {
+    const auto kFound = material_map.find(uses[u].name);
+    if (kFound == material_map.end()) {
+      std::cerr << "Material " << uses[u].name << " not found." << std::endl;
+      continue;
     }
 
-    for (size_t j = 0; j < 3; ++j) face_normals[i + j] = normal[j];
+    const size_t kFirst = uses[u].first_corner / 3;
+    const size_t kLast =
+        u + 1 < uses.size() ? uses[u + 1].first_corner / 3 : kTriangles;
+    std::fill(materials.begin() + kFirst, materials.begin() + kLast,
+              kFound->second);
+    max_material = std::max(max_material, kFound->second);
   }
 
-  const size_t kVertices = vertices.size();
-  normals->resize(kVertices, 0);
-  for (size_t i = 0; i < kFaces; i += 3) {
-    for (size_t j = 0; j < 3; ++j) {
-      size_t idx = static_cast<size_t>(faces[i + j]);
-      glm::vec3 v1(vertices[faces[i + j] * 3],
-                         vertices[faces[i + j] * 3 + 1],
-                         vertices[faces[i + j] * 3 + 2]);
-      glm::vec3 v2(vertices[faces[i + (j + 1) % 3] * 3],
-                         vertices[faces[i + (j + 1) % 3] * 3 + 1],
-                         vertices[faces[i + (j + 1) % 3] * 3 + 2]);
-      glm::vec3 v3(vertices[faces[i + (j + 2) % 3] * 3],
-                         vertices[faces[i + (j + 2) % 3] * 3 + 1],
-                         vertices[faces[i + (j + 2) % 3] * 3 + 2]);
-
-      glm::vec3 v1v2 = v2 - v1;
-      glm::vec3 v1v3 = v3 - v1;
-      double angle = acos(glm::dot(v1v2,v1v3) / (glm::length(v1v2) * glm::length(v1v3)));
-
-      if (angle == angle) {
-        for (size_t k = 0; k < 3; ++k) {
-          (*normals)[idx * 3 + k] += face_normals[i + k] * angle;
-        }
-      }
+  // Bucket 0 holds the triangles without material.
+  const size_t kBuckets = static_cast<size_t>(max_material + 2);
+  const size_t kChunks = NumChunks(kTriangles, 1 << 16);
+  std::vector<size_t> offsets(kChunks * kBuckets, 0);
+  ParallelForChunks(kTriangles, kChunks, [&](size_t c, size_t begin,
+                                             size_t end) {
+    for (size_t t = begin; t < end; ++t)
+      ++offsets[c * kBuckets + materials[t] + 1];
+  });
+
+  std::vector<size_t> bucket_sizes(kBuckets, 0);
+  size_t offset = 0;
+  for (size_t b = 0; b < kBuckets; ++b) {
+    for (size_t c = 0; c < kChunks; ++c) {
+      const size_t kCount = offsets[c * kBuckets + b];
+      offsets[c * kBuckets + b] = offset;
+      offset += kCount;
+      bucket_sizes[b] += kCount;
     }
   }
 
-  const size_t kNormals = normals->size();
-  for (size_t i = 0; i < kNormals; i += 3) {
-    glm::vec3 normal((*normals)[i], (*normals)[i + 1], (*normals)[i + 2]);
-    if (glm::length(normal) > 0) {
-      glm::normalize(normal);
-    } else {
-      normal = glm::vec3(0, 0, 0);
+  std::vector<ObjCorner> sorted(corners->size());
+  ParallelForChunks(kTriangles, kChunks, [&](size_t c, size_t begin,
+                                             size_t end) {
+    size_t *bucket_offsets = &offsets[c * kBuckets];
+    for (size_t t = begin; t < end; ++t) {
+      const size_t kTarget = bucket_offsets[materials[t] + 1]++;
+      for (size_t j = 0; j < 3; ++j)
+        sorted[kTarget * 3 + j] = (*corners)[t * 3 + j];
     }
-
-    for (size_t j = 0; j < 3; ++j) (*normals)[i + j] = normal[j];
+  });
+  corners->swap(sorted);
+
+  submeshes->clear();
+  size_t first = 0;
+  for (size_t b = 0; b < kBuckets; ++b) {
+    if (bucket_sizes[b] == 0) continue;
+    Submesh submesh;
+    submesh.first = static_cast<unsigned int>(first * 3);
+    submesh.count = static_cast<unsigned int>(bucket_sizes[b] * 3);
+    submesh.material = static_cast<int>(b) - 1;
+    submeshes->push_back(submesh);
+    first += bucket_sizes[b];
   }
 }
 
-void ComputeTexCoords(const std::vector<float> &vertices,
-                      std::vector<float> *texCoords) {
-
-    const size_t kVertices = vertices.size()/3;
-    texCoords->resize(kVertices*2, 0);
-    for(auto i = 0; i < vertices.size()/3; ++i) {
-
-       float longitudeRadians = atan2(vertices[i*3+1], vertices[i*3+0]);
-       float latitudeRadians = asin(vertices[i*3+2]);
-
-       // Convert range -PI...PI to 0...1
-       float s =  longitudeRadians/(2 * M_PI) + 0.5;
+void ComputeSubmeshBounds(TriangleMesh *mesh) {
+  for (auto &submesh : mesh->submeshes_) {
+    const size_t kChunks = NumChunks(submesh.count, 1 << 16);
+    std::vector<glm::vec3> mins(
+        kChunks, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> maxs(
+        kChunks, glm::vec3(std::numeric_limits<float>::lowest()));
+    ParallelForChunks(submesh.count, kChunks, [&](size_t c, size_t begin,
+                                                  size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        const int kVertex = mesh->faces_[submesh.first + i];
+        const glm::vec3 kPosition(mesh->vertices_[kVertex * 3],
+                                  mesh->vertices_[kVertex * 3 + 1],
+                                  mesh->vertices_[kVertex * 3 + 2]);
+        mins[c] = glm::min(mins[c], kPosition);
+        maxs[c] = glm::max(maxs[c], kPosition);
+      }
+    });
 
-       // Convert range -PI/2...PI/2 to 0...1
-       float t =  latitudeRadians/M_PI + 0.5;
-       (*texCoords)[i*2] = s;
-       (*texCoords)[i*2+1] = t;
+    submesh.min = mins[0];
+    submesh.max = maxs[0];
+    for (size_t c = 1; c < kChunks; ++c) {
+      submesh.min = glm::min(submesh.min, mins[c]);
+      submesh.max = glm::max(submesh.max, maxs[c]);
     }
-
-}
-void ComputeBoundingBox(const std::vector<float> vertices, TriangleMesh *mesh) {
-  const size_t kVertices = vertices.size() / 3;
-  for (size_t i = 0; i < kVertices; ++i) {
-    mesh->min_[0] = std::min(mesh->min_[0], vertices[i * 3]);
-    mesh->min_[1] = std::min(mesh->min_[1], vertices[i * 3 + 1]);
-    mesh->min_[2] = std::min(mesh->min_[2], vertices[i * 3 + 2]);
-
-    mesh->max_[0] = std::max(mesh->max_[0], vertices[i * 3]);
-    mesh->max_[1] = std::max(mesh->max_[1], vertices[i * 3 + 1]);
-    mesh->max_[2] = std::max(mesh->max_[2], vertices[i * 3 + 2]);
   }
 }
 
 }  // namespace
 
-bool ReadFromPly(const std::string &filename, TriangleMesh *mesh) {
-  std::ifstream fin;
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 LoadProfile *profile, uint32_t attributes) {
+  mesh->Clear();
 
-  fin.open(filename.c_str(), std::ios_base::in | std::ios_base::binary);
-  if (!fin.is_open() || !fin.good()) return false;
+  MappedFile file;
+  {
+    ScopedStage stage(profile, "map file");
+    if (!file.Open(filename)) return false;
+    stage.set_bytes(file.size());
+  }
 
-  int vertices = 0, faces = 0;
-  if (!ReadPlyHeader(&fin, &vertices, &faces)) {
-    fin.close();
-    return false;
+  PlySchema schema;
+  {
+    ScopedStage stage(profile, "header");
+    if (!ParsePlyHeader(file.data(), file.size(), &schema)) return false;
+    stage.set_bytes(schema.header_size);
   }
 
-  mesh->vertices_.resize(static_cast<size_t>(vertices) * 3);
-  if(hasNormals) mesh->normals_.resize(static_cast<size_t>(vertices) * 3);
-  ReadPlyVertices(&fin, mesh);
+  const PlyElement *vertices = schema.FindElement("vertex");
+  const PlyElement *faces = schema.FindElement("face");
+  if (vertices == nullptr || vertices->count == 0) return false;
+
+  std::cout << "Loading triangle mesh" << std::endl;
+  std::cout << "\tVertices = " << vertices->count << std::endl;
+  std::cout << "\tFaces = " << (faces != nullptr ? faces->count : 0)
+            << std::endl;
 
-  mesh->faces_.resize(static_cast<size_t>(faces) * 3);
-  ReadPlyFaces(&fin, mesh);
+  if (!DecodePly(file.data(), file.size(), schema, mesh, profile)) {
+    std::cerr << "Could not decode " << filename << std::endl;
+    return false;
+  }
 
-  fin.close();
+  file.Close();
 
-  if(!hasNormals) ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_);
-  ComputeTexCoords(mesh->vertices_, &mesh->texCoords_);
-  ComputeBoundingBox(mesh->vertices_, mesh);
+  ComputeVertexAttributes(attributes, mesh, profile);
 
   return true;
 }
 
 bool WriteToPly(const std::string &filename, const TriangleMesh &mesh) {
-  (void)filename;
-  (void)mesh;
-
-  std::cerr << "Not yet implemented" << std::endl;
-
-  // TODO(students): Implement storing to PLY format.
-
-  // END.
-
-  return false;
+  std::ofstream fout;
+
+  fout.open(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+  if (!fout.is_open() || !fout.good()) return false;
+
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  const size_t kFaces = mesh.faces_.size() / 3;
+  const bool kNormals = mesh.normals_.size() == kVertices * 3;
+  const bool kTexCoords = mesh.texCoords_.size() == kVertices * 2;
+
+  fout << "ply\n";
+  fout << (IsHostLittleEndian() ? "format binary_little_endian 1.0\n"
+                                : "format binary_big_endian 1.0\n");
+  fout << "element vertex " << kVertices << "\n";
+  fout << "property float x\nproperty float y\nproperty float z\n";
+  if (kNormals)
+    fout << "property float nx\nproperty float ny\nproperty float nz\n";
+  if (kTexCoords) fout << "property float s\nproperty float t\n";
+  fout << "element face " << kFaces << "\n";
+  fout << "property list uchar int vertex_indices\n";
+  fout << "end_header\n";
+
+  const size_t kVertexStride =
+      sizeof(float) * (3 + (kNormals ? 3 : 0) + (kTexCoords ? 2 : 0));
+  bool res = WriteRecords(
+      &fout, kVertices, kVertexStride, [&](size_t i, char *record) {
+        memcpy(record, &mesh.vertices_[i * 3], 3 * sizeof(float));
+        record += 3 * sizeof(float);
+        if (kNormals) {
+          memcpy(record, &mesh.normals_[i * 3], 3 * sizeof(float));
+          record += 3 * sizeof(float);
+        }
+        if (kTexCoords)
+          memcpy(record, &mesh.texCoords_[i * 2], 2 * sizeof(float));
+      });
+
+  const size_t kFaceStride = sizeof(unsigned char) + 3 * sizeof(int);
+  res = res && WriteRecords(&fout, kFaces, kFaceStride,
+                            [&](size_t i, char *record) {
+                              record[0] = 3;
+                              memcpy(record + 1, &mesh.faces_[i * 3],
+                                     3 * sizeof(int));
+                            });
+
+  fout.close();
+  return res && !fout.fail();
 }
 
-bool ReadFromObj(const std::string &filename, TriangleMesh *mesh)
-{
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-
-    std::string warn;
-    std::string err;
+bool ReadFromObj(const std::string &filename, TriangleMesh *mesh,
+                 LoadProfile *profile, uint32_t attributes) {
+  mesh->Clear();
 
-    std::string baseDir = filename.substr(0, filename.rfind("/"));
-
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str(),baseDir.c_str());
-
-    if (!warn.empty()) {
-      std::cout << warn << std::endl;
-    }
+  MappedFile file;
+  {
+    ScopedStage stage(profile, "map file");
+    if (!file.Open(filename)) return false;
+    stage.set_bytes(file.size());
+  }
 
-    if (!err.empty()) {
-      std::cerr << err << std::endl;
+  ObjData obj;
+  {
+    ScopedStage stage(profile, "parse", file.size());
+    if (!ParseObj(file.data(), file.size(), &obj)) {
+      std::cerr << "Could not parse " << filename << std::endl;
+      return false;
     }
+  }
+  file.Close();
 
-    if (!ret) {
-      exit(1);
+  std::cout << "Loading triangle mesh" << std::endl;
+  std::cout << "\tVertices = " << obj.positions.size() / 3 << std::endl;
+  std::cout << "\tFaces = " << obj.corners.size() / 3 << std::endl;
+
+  const size_t kSlash = filename.rfind("/");
+  const std::string kBaseDir =
+      kSlash == std::string::npos ? "." : filename.substr(0, kSlash);
+  std::map<std::string, int> material_map;
+  {
+    ScopedStage stage(profile, "materials");
+    const std::vector<tinyobj::material_t> kMaterials =
+        ReadObjMaterials(kBaseDir, obj.material_libraries, &material_map);
+    for (const auto &material : kMaterials) {
+      mesh->materials_.push_back({material.name, ""});
+      if (!material.diffuse_texname.empty())
+        mesh->materials_.back().diffuse_map =
+            kBaseDir + "/" + material.diffuse_texname;
     }
+    if (!kMaterials.empty())
+      mesh->diffuseMap_ = kBaseDir + "/" + kMaterials[0].diffuse_texname;
+  }
 
-    int currentIndex = 0;
-    for(const auto& shape: shapes)
-    {
-        mesh->faces_.resize(mesh->faces_.size()+shape.mesh.indices.size());
-        mesh->vertices_.resize((mesh->vertices_.size()+shape.mesh.indices.size())*3);
-        if(attrib.normals.size() > 0)
-            mesh->normals_.resize((mesh->normals_.size()+shape.mesh.indices.size())*3);
-        if(attrib.texcoords.size() > 0)
-            mesh->texCoords_.resize((mesh->texCoords_.size()+shape.mesh.indices.size())*2);
-
-        for(const auto& nfv : shape.mesh.num_face_vertices)
-            if(size_t(nfv) != 3) {
-                std::cerr << "Only supports triangles." << std::endl;
-                exit(1);
-            }
-
-        for(const auto& index : shape.mesh.indices)
-        {
-            //auto currentIndex = mesh->faces_.size();
-            mesh->faces_[currentIndex] = currentIndex;
-
-            mesh->vertices_[3*currentIndex]   = attrib.vertices[3*index.vertex_index];
-            mesh->vertices_[3*currentIndex+1] = attrib.vertices[3*index.vertex_index+1];
-            mesh->vertices_[3*currentIndex+2] = attrib.vertices[3*index.vertex_index+2];
-
-            if(attrib.normals.size() > 0) {
-                mesh->normals_[3*currentIndex]   = attrib.normals[3*index.normal_index];
-                mesh->normals_[3*currentIndex+1] = attrib.normals[3*index.normal_index+1];
-                mesh->normals_[3*currentIndex+2] = attrib.normals[3*index.normal_index+2];
-            }
-
-            if(attrib.texcoords.size() > 0) {
-                mesh->texCoords_[2*currentIndex]   = attrib.texcoords[2*index.texcoord_index];
-                mesh->texCoords_[2*currentIndex+1] = 1.f -attrib.texcoords[2*index.texcoord_index+1];
-            }
+  const uint64_t kCornerBytes = sizeof(ObjCorner) * obj.corners.size();
+  if (!obj.material_uses.empty()) {
+    ScopedStage stage(profile, "material sort", kCornerBytes);
+    SortTrianglesByMaterial(obj.material_uses, material_map, &obj.corners,
+                            &mesh->submeshes_);
+  }
 
-            //std::cout << mesh->vertices_[3*currentIndex] << " " << mesh->vertices_[3*currentIndex+1] << " " << mesh->vertices_[3*currentIndex+2] << std::endl;
+  std::vector<ObjCorner> vertices;
+  {
+    ScopedStage stage(profile, "index corners", kCornerBytes);
+    IndexObjCorners(obj.corners, &mesh->faces_, &vertices);
+    std::vector<ObjCorner>().swap(obj.corners);
+  }
 
-            currentIndex++;
+  const size_t kVertices = vertices.size();
+  // Corners without a normal or texture coordinates would be left with zero
+  // ones, so partial attributes are dropped and computed for the whole mesh
+  // instead.
+  const bool kNormals =
+      !obj.normals.empty() &&
+      std::none_of(vertices.begin(), vertices.end(),
+                   [](const ObjCorner &vertex) { return vertex.normal < 0; });
+  const bool kTexCoords =
+      !obj.texcoords.empty() &&
+      std::none_of(vertices.begin(), vertices.end(),
+                   [](const ObjCorner &vertex) { return vertex.texcoord < 0; });
+  {
+    ScopedStage stage(profile, "attributes");
+    mesh->vertices_.resize(kVertices * 3);
+    if (kNormals) mesh->normals_.resize(kVertices * 3);
+    if (kTexCoords) mesh->texCoords_.resize(kVertices * 2);
+
+    ParallelFor(kVertices, 1 << 15, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        const ObjCorner &vertex = vertices[i];
+
+        for (size_t j = 0; j < 3; ++j)
+          mesh->vertices_[i * 3 + j] = obj.positions[vertex.position * 3 + j];
+
+        if (kNormals) {
+          for (size_t j = 0; j < 3; ++j)
+            mesh->normals_[i * 3 + j] = obj.normals[vertex.normal * 3 + j];
         }
-    }
 
-    if(attrib.normals.size() == 0)
-        ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_);
-
-    ComputeBoundingBox(mesh->vertices_, mesh);
+        if (kTexCoords) {
+          mesh->texCoords_[i * 2] = obj.texcoords[vertex.texcoord * 2];
+          mesh->texCoords_[i * 2 + 1] =
+              1.f - obj.texcoords[vertex.texcoord * 2 + 1];
+        }
+      }
+    });
+    stage.set_bytes(sizeof(float) * (mesh->vertices_.size() +
+                                     mesh->normals_.size() +
+                                     mesh->texCoords_.size()));
+  }
 
-    if(materials.size() > 0)
-    {
-        mesh->diffuseMap_ = baseDir+"/"+materials[0].diffuse_texname;
-    }
-    //for(auto i = 0; i < mesh->texCoords_.size(); i+=2)
-    //    std::cout << mesh->texCoords_[i] << " " << mesh->texCoords_[i+1] << std::endl;
+  ComputeVertexAttributes(attributes, mesh, profile);
+  if (!mesh->submeshes_.empty()) {
+    ScopedStage stage(profile, "submesh bounds",
+                      sizeof(int) * mesh->faces_.size());
+    ComputeSubmeshBounds(mesh);
+  }
 
+  return true;
 }
 
 bool CreateSphere(TriangleMesh *mesh)
@@ -404,7 +478,7 @@ bool CreateSphere(TriangleMesh *mesh)
     mesh->normals_ = normals;
     mesh->texCoords_ = texCoords;
 
-    ComputeBoundingBox(mesh->vertices_, mesh);
+    ComputeVertexAttributes(0, mesh);
 
     return true;
 
@@ -3,26 +3,35 @@
 #ifndef MESH_IO_H_
 #define MESH_IO_H_
 
+#include <load_profile.h>
 #include <triangle_mesh.h>
+#include <vertex_attributes.h>
+
+#include <cstdint>
 
 #include <string>
 
 namespace data_representation {
 
-static bool hasNormals = false;
-
 /**
  * @brief ReadFromPly Read the mesh stored in PLY format at the path filename
  * and stores the corresponding TriangleMesh representation
  * @param filename The path to the PLY mesh.
- * @param mesh The resulting representation with computed per-vertex normals.
+ * @param mesh The resulting representation with its bounding box.
+ * @param profile If not null, receives the timing of every stage.
+ * @param attributes The attributes to compute if the file does not provide
+ * them, see ComputeVertexAttributes.
  * @return Whether it was able to read the file.
  */
-bool ReadFromPly(const std::string &filename, TriangleMesh *mesh);
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 LoadProfile *profile = nullptr,
+                 uint32_t attributes = kAllVertexAttributes);
 
 /**
  * @brief WriteToPly Stores the mesh representation in PLY format at the path
- * filename.
+ * filename: the positions, the normals and texture coordinates (as s/t) if
+ * the mesh has them for every vertex, and the faces. Vertex streams, levels
+ * of detail and materials are not written.
  * @param filename The path where the mesh will be stored.
  * @param mesh The mesh to be stored.
  * @return Whether it was able to store the file.
@@ -31,13 +40,21 @@ bool WriteToPly(const std::string &filename, const TriangleMesh &mesh);
 
 /**
  * @brief ReadFromObj Read the mesh stored in OBJ format at the path filename
- * and stores the corresponding TriangleMesh representation. It only works for
- * models with a unique material.
+ * and stores the corresponding TriangleMesh representation. Corners sharing the
+ * same position, texture coordinate and normal are merged into a single
+ * vertex. Faces are sorted by material and every material gets its own
+ * submesh. Normals and texture coordinates are only taken from the file if
+ * every corner has them, and otherwise count as missing.
  * @param filename The path to the OBJ mesh.
- * @param mesh The resulting representation with computed per-vertex normals.
+ * @param mesh The resulting representation with its bounding box.
+ * @param profile If not null, receives the timing of every stage.
+ * @param attributes The attributes to compute if the file does not provide
+ * them, see ComputeVertexAttributes.
  * @return Whether it was able to read the file.
  */
-bool ReadFromObj(const std::string &filename, TriangleMesh *mesh);
+bool ReadFromObj(const std::string &filename, TriangleMesh *mesh,
+                 LoadProfile *profile = nullptr,
+                 uint32_t attributes = kAllVertexAttributes);
 
 /**
  * @brief CreateSphere Creates an sphere
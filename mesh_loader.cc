@@ -0,0 +1,320 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <mesh_loader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./ambient_occlusion.h"
+#include "./mesh_cache.h"
+#include "./mesh_cleanup.h"
+#include "./mesh_io.h"
+#include "./mesh_optimizer.h"
+#include "./meshlet.h"
+#include "./mesh_simplifier.h"
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/**
+ * @brief The PostProcess enum Passes applied after parsing, stored in the
+ * cache so that caches are not shared between different settings.
+ */
+enum PostProcess : uint32_t {
+  kVertexCacheOptimization = 1 << 0,
+  kOverdrawOptimization = 1 << 1,
+  kMeshletBuild = 1 << 2,
+  kMeshCleanup = 1 << 3,
+  kSpatialSort = 1 << 4,
+
+  /**
+   * @brief kLodCountShift The number of levels of detail is stored in the
+   * bits from this one.
+   */
+  kLodCountShift = 8,
+
+  /**
+   * @brief kOcclusionRaysShift The number of rays of the baked ambient
+   * occlusion is stored in the bits from this one.
+   */
+  kOcclusionRaysShift = 16
+};
+
+uint32_t PostProcessFlags(const LoadOptions &options) {
+  uint32_t flags = 0;
+  if (options.optimize_vertex_cache) flags |= kVertexCacheOptimization;
+  if (options.optimize_overdraw) flags |= kOverdrawOptimization;
+  if (options.build_meshlets) flags |= kMeshletBuild;
+  if (options.clean_mesh) flags |= kMeshCleanup;
+  if (options.spatial_sort) flags |= kSpatialSort;
+  flags |= static_cast<uint32_t>(std::min<size_t>(options.lod_count, 0xFF))
+           << kLodCountShift;
+  flags |=
+      static_cast<uint32_t>(std::min<size_t>(options.occlusion_rays, 0xFFFF))
+      << kOcclusionRaysShift;
+  return flags;
+}
+
+void Report(const LoadOptions &options, const std::string &stage,
+            float fraction) {
+  if (options.progress) options.progress(stage, fraction);
+}
+
+/**
+ * @brief ReportLods Records the size and error of every level of detail.
+ */
+void ReportLods(const TriangleMesh &mesh, LoadProfile *profile) {
+  for (size_t i = 0; i < mesh.lods_.size(); ++i) {
+    const MeshLod &kLod = mesh.lods_[i];
+    const std::string kName = "lod" + std::to_string(i + 1);
+    if (profile != nullptr) {
+      profile->SetMetric(kName + "_triangles", kLod.faces.size() / 3);
+      profile->SetMetric(kName + "_error", kLod.error);
+    }
+    std::cout << "LOD " << i + 1 << ": " << kLod.faces.size() / 3
+              << " triangles, error " << kLod.error << std::endl;
+  }
+}
+
+void BuildBvh(const TriangleMesh &mesh, Bvh *bvh, LoadProfile *profile) {
+  ScopedStage stage(profile, "bvh build");
+  bvh->Build(mesh);
+  stage.set_bytes(bvh->bytes());
+}
+
+}  // namespace
+
+bool LoadMesh(const std::string &filename, const LoadOptions &options,
+              TriangleMesh *mesh) {
+  const auto kStart = std::chrono::steady_clock::now();
+  LoadProfile *profile = options.profile;
+  if (profile != nullptr) profile->Clear();
+  const uint32_t kPostProcess = PostProcessFlags(options);
+  // Read first, so that a change during the load does not go unnoticed.
+  if (options.source_key != nullptr &&
+      !ReadSourceKey(filename, options.source_key)) {
+    std::cerr << "Could not read " << filename << std::endl;
+    return false;
+  }
+
+  if (options.use_cache) {
+    Report(options, "Reading cache", 0.0f);
+    bool cached;
+    {
+      ScopedStage stage(profile, "cache read");
+      cached = ReadFromCache(filename, options.cache_dir, kPostProcess, mesh);
+      if (cached) stage.set_bytes(mesh->ResidentBytes());
+    }
+    if (cached) {
+      ReportLods(*mesh, profile);
+      // The cache may have been written for settings that needed fewer
+      // attributes.
+      const uint32_t kMissing =
+          MissingVertexAttributes(*mesh, options.attributes);
+      if (kMissing != 0) ComputeVertexAttributes(kMissing, mesh, profile);
+      mesh->InvalidateAdjacency();
+      if (options.bvh != nullptr) BuildBvh(*mesh, options.bvh, profile);
+      std::cout << "Loaded " << filename << " from cache in "
+                << MillisecondsSince(kStart) << " ms" << std::endl;
+      Report(options, "Done", 1.0f);
+      return true;
+    }
+  }
+
+  const size_t kDot = filename.find_last_of(".");
+  const std::string kType =
+      kDot == std::string::npos ? "" : filename.substr(kDot + 1);
+
+  Report(options, "Parsing", 0.1f);
+  // Attributes are derived after the passes that remove or move vertices.
+  const bool kDeferAttributes = options.clean_mesh || options.spatial_sort;
+  const uint32_t kAttributes = kDeferAttributes ? 0 : options.attributes;
+  bool res = false;
+  if (kType.compare("ply") == 0) {
+    res = ReadFromPly(filename, mesh, profile, kAttributes);
+  } else if (kType.compare("obj") == 0) {
+    res = ReadFromObj(filename, mesh, profile, kAttributes);
+  }
+  if (!res) return false;
+
+  std::cout << "Parsed " << filename << " in " << MillisecondsSince(kStart)
+            << " ms" << std::endl;
+
+  if (options.clean_mesh) {
+    Report(options, "Cleaning up", 0.3f);
+    CleanupStats stats;
+    {
+      ScopedStage stage(profile, "cleanup", mesh->ResidentBytes());
+      CleanMesh(mesh, kWeldEpsilon, &stats);
+    }
+    if (profile != nullptr) {
+      profile->SetMetric("welded_vertices", stats.welded_vertices);
+      profile->SetMetric("unused_vertices", stats.unused_vertices);
+      profile->SetMetric("degenerate_triangles", stats.degenerate_triangles);
+      profile->SetMetric("duplicate_triangles", stats.duplicate_triangles);
+      profile->SetMetric("cleanup_bytes_saved", stats.bytes_saved);
+    }
+    std::cout << "Cleanup: " << stats.welded_vertices << " welded and "
+              << stats.unused_vertices << " unused vertices, "
+              << stats.degenerate_triangles << " degenerate and "
+              << stats.duplicate_triangles << " duplicate triangles, "
+              << stats.bytes_saved << " bytes saved" << std::endl;
+  }
+
+  if (options.spatial_sort) {
+    Report(options, "Sorting spatially", 0.4f);
+    ScopedStage stage(profile, "spatial sort", mesh->ResidentBytes());
+    SpatialSort(mesh);
+  }
+
+  if (kDeferAttributes)
+    ComputeVertexAttributes(options.attributes, mesh, profile);
+
+  if (options.lod_count > 0) {
+    Report(options, "Simplifying", 0.5f);
+    GenerateLods(mesh, options.lod_count, kMaxLodError, profile);
+    ReportLods(*mesh, profile);
+  }
+
+  if (options.optimize_vertex_cache || options.optimize_overdraw) {
+    Report(options, "Optimizing triangle order", 0.8f);
+    const VertexCacheStats kBefore = AnalyzeVertexCache(mesh->faces_);
+    if (options.optimize_vertex_cache) {
+      ScopedStage stage(profile, "vertex cache optimization",
+                        sizeof(int) * mesh->faces_.size());
+      OptimizeVertexCache(mesh);
+    }
+    if (options.optimize_overdraw) {
+      ScopedStage stage(profile, "overdraw optimization",
+                        sizeof(int) * mesh->faces_.size());
+      OptimizeOverdraw(mesh);
+    }
+    {
+      ScopedStage stage(profile, "vertex fetch optimization",
+                        mesh->ResidentBytes());
+      OptimizeVertexFetch(mesh);
+    }
+    const VertexCacheStats kAfter = AnalyzeVertexCache(mesh->faces_);
+    if (profile != nullptr) {
+      profile->SetMetric("acmr_before", kBefore.acmr);
+      profile->SetMetric("acmr_after", kAfter.acmr);
+      profile->SetMetric("atvr_before", kBefore.atvr);
+      profile->SetMetric("atvr_after", kAfter.atvr);
+    }
+    std::cout << "ACMR " << kBefore.acmr << " -> " << kAfter.acmr << ", ATVR "
+              << kBefore.atvr << " -> " << kAfter.atvr << std::endl;
+  }
+
+  if (options.build_meshlets) {
+    ScopedStage stage(profile, "meshlet build",
+                      sizeof(int) * mesh->faces_.size());
+    BuildMeshlets(mesh);
+    if (profile != nullptr)
+      profile->SetMetric("meshlets", mesh->meshlets_.size());
+    std::cout << mesh->meshlets_.size() << " meshlets" << std::endl;
+  }
+
+  if (options.occlusion_rays > 0 || options.bvh != nullptr) {
+    Bvh local_bvh;
+    Bvh *bvh = options.bvh != nullptr ? options.bvh : &local_bvh;
+    BuildBvh(*mesh, bvh, profile);
+    if (options.occlusion_rays > 0) {
+      Report(options, "Baking ambient occlusion", 0.85f);
+      ScopedStage stage(profile, "occlusion bake",
+                        sizeof(float) * mesh->vertices_.size() / 3);
+      BakeAmbientOcclusion(mesh, *bvh, options.occlusion_rays);
+    }
+  }
+
+  // The adjacency is shared by the passes above and not needed afterwards.
+  mesh->InvalidateAdjacency();
+
+  if (options.use_cache) {
+    Report(options, "Writing cache", 0.9f);
+    ScopedStage stage(profile, "cache write", mesh->ResidentBytes());
+    if (!WriteToCache(filename, options.cache_dir, kPostProcess, *mesh))
+      std::cerr << "Could not write the cache of " << filename << std::endl;
+  }
+
+  Report(options, "Done", 1.0f);
+  return true;
+}
+
+bool ReloadMeshArrays(const std::string &filename, const SourceKey &key,
+                      const LoadOptions &options, TriangleMesh *mesh) {
+  if (!mesh->released()) return true;
+
+  if (!SourceUnchanged(filename, key)) {
+    std::cerr << filename << " changed since it was loaded" << std::endl;
+    return false;
+  }
+  LoadOptions reload_options = options;
+  reload_options.progress = nullptr;
+  reload_options.profile = nullptr;
+  reload_options.bvh = nullptr;
+  reload_options.source_key = nullptr;
+  TriangleMesh reloaded;
+  if (!LoadMesh(filename, reload_options, &reloaded)) {
+    std::cerr << "Could not reload " << filename << std::endl;
+    return false;
+  }
+  *mesh = std::move(reloaded);
+  return true;
+}
+
+bool LoadMeshes(const std::vector<std::string> &filenames,
+                const LoadOptions &options, std::vector<TriangleMesh> *meshes,
+                std::vector<bool> *loaded) {
+  const size_t kFiles = filenames.size();
+  meshes->clear();
+  meshes->resize(kFiles);
+  std::vector<char> results(kFiles, 0);
+  if (kFiles == 0) return true;
+
+  const size_t kThreads = NumThreads();
+  const size_t kWorkers = std::min(kThreads, kFiles);
+  const size_t kThreadsPerLoad = std::max<size_t>(1, kThreads / kWorkers);
+
+  LoadOptions file_options = options;
+  file_options.progress = nullptr;
+  file_options.profile = nullptr;
+  file_options.bvh = nullptr;
+  file_options.source_key = nullptr;
+
+  // Files are handed out one at a time, as their sizes can differ widely.
+  std::atomic<size_t> next(0);
+  std::mutex progress_mutex;
+  size_t done = 0;
+  ParallelForChunks(kWorkers, kWorkers, [&](size_t, size_t, size_t) {
+    ScopedThreadBudget budget(kThreadsPerLoad);
+    for (size_t i = next++; i < kFiles; i = next++) {
+      results[i] = LoadMesh(filenames[i], file_options, &(*meshes)[i]);
+
+      std::lock_guard<std::mutex> lock(progress_mutex);
+      ++done;
+      if (options.progress)
+        options.progress(std::to_string(done) + "/" + std::to_string(kFiles),
+                         static_cast<float>(done) / kFiles);
+    }
+  });
+
+  if (loaded != nullptr) loaded->assign(results.begin(), results.end());
+  return std::find(results.begin(), results.end(), 0) == results.end();
+}
+
+}  // namespace data_representation
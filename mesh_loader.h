@@ -0,0 +1,170 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef MESH_LOADER_H_
+#define MESH_LOADER_H_
+
+#include <bvh.h>
+#include <load_profile.h>
+#include <mesh_cache.h>
+#include <triangle_mesh.h>
+#include <vertex_attributes.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief LoadProgress Callback receiving the current stage of a load and the
+ * completed fraction in [0, 1]. It is invoked on the loading thread.
+ */
+typedef std::function<void(const std::string &stage, float fraction)>
+    LoadProgress;
+
+/**
+ * @brief The LoadOptions struct Settings that control how a mesh file is
+ * turned into a TriangleMesh.
+ */
+struct LoadOptions {
+  /**
+   * @brief use_cache Whether to read and write the binary mesh cache.
+   */
+  bool use_cache = true;
+
+  /**
+   * @brief cache_dir Directory holding the caches. If empty, caches are
+   * written next to the source file.
+   */
+  std::string cache_dir;
+
+  /**
+   * @brief attributes The vertex attributes to compute when the file does
+   * not provide them, a mask of VertexAttribute values. Leaving out the
+   * unused ones shortens the load; caches without them are completed on
+   * read.
+   */
+  uint32_t attributes = kAllVertexAttributes;
+
+  /**
+   * @brief clean_mesh Whether to weld the vertices closer than kWeldEpsilon,
+   * remove the degenerate and duplicated triangles and compact the vertices
+   * after parsing, see CleanMesh. The attributes are then derived from the
+   * cleaned mesh.
+   */
+  bool clean_mesh = false;
+
+  /**
+   * @brief spatial_sort Whether to sort the vertices and triangles along a
+   * Z-order curve after parsing and cleaning up, see SpatialSort, so that the
+   * passes that follow walk through memory in spatial order. The attributes
+   * are then derived from the sorted mesh.
+   */
+  bool spatial_sort = false;
+
+  /**
+   * @brief optimize_vertex_cache Whether to reorder the triangles for the
+   * post-transform vertex cache and the vertices by first use after parsing.
+   */
+  bool optimize_vertex_cache = false;
+
+  /**
+   * @brief optimize_overdraw Whether to reorder the triangles to reduce
+   * overdraw after parsing, following the vertex cache optimization if it is
+   * enabled.
+   */
+  bool optimize_overdraw = false;
+
+  /**
+   * @brief lod_count Maximum number of levels of detail generated after
+   * parsing, see GenerateLods. 0 disables them.
+   */
+  size_t lod_count = 0;
+
+  /**
+   * @brief build_meshlets Whether to partition the faces into meshlets for
+   * culling after the other passes, see BuildMeshlets.
+   */
+  bool build_meshlets = false;
+
+  /**
+   * @brief occlusion_rays Number of rays per vertex of the ambient occlusion
+   * baked after the other passes, see BakeAmbientOcclusion. 0 disables it.
+   */
+  size_t occlusion_rays = 0;
+
+  /**
+   * @brief bvh If not null, receives the bounding volume hierarchy of the
+   * loaded mesh. The one built for baking is reused.
+   */
+  Bvh *bvh = nullptr;
+
+  /**
+   * @brief source_key If not null, receives the key of the source file, read
+   * before loading it, see ReloadMeshArrays.
+   */
+  SourceKey *source_key = nullptr;
+
+  /**
+   * @brief progress If set, called as the load goes through its stages.
+   */
+  LoadProgress progress;
+
+  /**
+   * @brief profile If not null, LoadMesh replaces its contents with the
+   * timing of every load stage.
+   */
+  LoadProfile *profile = nullptr;
+};
+
+/**
+ * @brief LoadMesh Loads the PLY or OBJ mesh at the path filename. If a valid
+ * binary cache exists it is used instead of parsing the file, otherwise the
+ * file is parsed and a cache is written for the next load.
+ * @param filename The path to the mesh.
+ * @param options The load settings.
+ * @param mesh The resulting representation with computed per-vertex normals.
+ * @return Whether it was able to load the file.
+ */
+bool LoadMesh(const std::string &filename, const LoadOptions &options,
+              TriangleMesh *mesh);
+
+/**
+ * @brief ReloadMeshArrays Brings back the arrays of a mesh freed with
+ * TriangleMesh::ReleaseArrays by loading it again, which reads the binary
+ * cache unless it is disabled or gone. The progress, profile, bvh and
+ * source_key of the options are ignored.
+ * @param filename The path the mesh was loaded from.
+ * @param key The key of the file when the mesh was loaded, see
+ * LoadOptions::source_key.
+ * @param options The settings the mesh was loaded with, so that the same
+ * cache is found. Their attributes may ask for more.
+ * @param mesh The released mesh, replaced by the reloaded one. Left as it is
+ * if the file no longer matches the key or the load fails.
+ * @return Whether the arrays are resident.
+ */
+bool ReloadMeshArrays(const std::string &filename, const SourceKey &key,
+                      const LoadOptions &options, TriangleMesh *mesh);
+
+/**
+ * @brief LoadMeshes Loads several meshes concurrently with LoadMesh. Every
+ * worker thread picks the next pending file, and the hardware threads are
+ * split among the workers for the parallel loops of each load. The loaders
+ * keep no shared state, so any number of loads may run at once.
+ * @param filenames The paths to the meshes.
+ * @param options The load settings. progress is called, serialized, after
+ * every file with the number of files done so far. profile, bvh and source_key
+ * are ignored.
+ * @param meshes The resulting representations, one per filename.
+ * @param loaded Whether each file was loaded. May be null.
+ * @return Whether all the files were loaded.
+ */
+bool LoadMeshes(const std::vector<std::string> &filenames,
+                const LoadOptions &options, std::vector<TriangleMesh> *meshes,
+                std::vector<bool> *loaded);
+
+}  // namespace data_representation
+
+#endif  // MESH_LOADER_H_
@@ -0,0 +1,487 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <mesh_optimizer.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "./mesh_adjacency.h"
+#include "./parallel.h"
+#include "./radix_sort.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief TriangleRanges Triangle ranges [first, end) that are reordered
+ * independently: one per submesh, or all the faces.
+ */
+std::vector<std::pair<size_t, size_t>> TriangleRanges(
+    const std::vector<int> &faces, const std::vector<Submesh> &submeshes) {
+  std::vector<std::pair<size_t, size_t>> ranges;
+  for (const auto &submesh : submeshes)
+    ranges.push_back(std::make_pair(submesh.first / 3,
+                                    (submesh.first + submesh.count) / 3));
+  if (ranges.empty()) ranges.push_back(std::make_pair(0, faces.size() / 3));
+  return ranges;
+}
+
+/**
+ * @brief TipsifyRange Reorders triangles in place with Tipsify: triangles are
+ * emitted as fans around a vertex, and the next fanning vertex is the
+ * candidate with live triangles that will still be in the cache, falling back
+ * to recently used vertices and then to the next vertex in order.
+ * @param indices Three global vertex indices per triangle.
+ * @param triangles The number of triangles in the range.
+ * @param local Three vertex indices per triangle, numbered from 0 to
+ * vertex_count - 1. May be indices itself.
+ * @param vertex_count The number of vertices of the numbering of local.
+ * @param adjacency The vertex-to-corner adjacency of local.
+ */
+void TipsifyRange(int *indices, size_t triangles, const int *local,
+                  size_t vertex_count, const CsrAdjacency &adjacency) {
+  const size_t kCorners = triangles * 3;
+  std::vector<uint32_t> live(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v) live[v] = adjacency.Count(v);
+  std::vector<size_t> stamps(vertex_count, 0);
+  std::vector<char> emitted(triangles, 0);
+  std::vector<int> dead_ends, candidates, output;
+  output.reserve(kCorners);
+
+  size_t time = kVertexCacheSize + 1;
+  size_t cursor = 0;
+  int fanning = 0;
+  while (fanning >= 0) {
+    candidates.clear();
+    for (const uint32_t *corner = adjacency.Begin(fanning);
+         corner != adjacency.End(fanning); ++corner) {
+      const size_t kTriangle = *corner / 3;
+      if (emitted[kTriangle]) continue;
+      emitted[kTriangle] = 1;
+
+      for (size_t k = 0; k < 3; ++k) {
+        const int kVertex = local[kTriangle * 3 + k];
+        output.push_back(indices[kTriangle * 3 + k]);
+        dead_ends.push_back(kVertex);
+        candidates.push_back(kVertex);
+        --live[kVertex];
+        if (time - stamps[kVertex] > kVertexCacheSize) stamps[kVertex] = time++;
+      }
+    }
+
+    fanning = -1;
+    size_t best_priority = 0;
+    for (int candidate : candidates) {
+      if (live[candidate] == 0) continue;
+      // Candidates whose fan would evict them from the cache rank lowest.
+      size_t priority = 0;
+      if (time - stamps[candidate] + 2 * live[candidate] <= kVertexCacheSize)
+        priority = time - stamps[candidate];
+      if (fanning < 0 || priority > best_priority) {
+        fanning = candidate;
+        best_priority = priority;
+      }
+    }
+
+    while (fanning < 0 && !dead_ends.empty()) {
+      if (live[dead_ends.back()] > 0) fanning = dead_ends.back();
+      dead_ends.pop_back();
+    }
+    while (fanning < 0 && cursor < vertex_count) {
+      if (live[cursor] > 0) fanning = static_cast<int>(cursor);
+      ++cursor;
+    }
+  }
+
+  std::copy(output.begin(), output.end(), indices);
+}
+
+/**
+ * @brief TipsifyLocalRange Runs TipsifyRange over a renumbering of the
+ * vertices of the range, which keeps the work proportional to its size.
+ * @param local_of Scratch map from global to local vertex index, all -1.
+ * It is restored before returning.
+ */
+void TipsifyLocalRange(int *indices, size_t triangles,
+                       std::vector<int> *local_of) {
+  const size_t kCorners = triangles * 3;
+  std::vector<int> local(kCorners);
+  size_t vertex_count = 0;
+  for (size_t c = 0; c < kCorners; ++c) {
+    int &index = (*local_of)[indices[c]];
+    if (index < 0) index = static_cast<int>(vertex_count++);
+    local[c] = index;
+  }
+  for (size_t c = 0; c < kCorners; ++c) (*local_of)[indices[c]] = -1;
+  if (vertex_count == 0) return;
+
+  CsrAdjacency adjacency;
+  BuildVertexCorners(local, vertex_count, &adjacency);
+  TipsifyRange(indices, triangles, local.data(), vertex_count, adjacency);
+}
+
+/**
+ * @brief The FifoCache class Vertex cache simulation with timestamps: a
+ * vertex is cached if fewer than kVertexCacheSize misses happened since it
+ * was loaded.
+ */
+class FifoCache {
+ public:
+  explicit FifoCache(size_t vertex_count)
+      : stamps_(vertex_count, 0), time_(kVertexCacheSize + 1) {}
+
+  /**
+   * @brief Access Transforms the three vertices of a triangle.
+   * @return The number of cache misses.
+   */
+  size_t Access(const int *triangle) {
+    size_t misses = 0;
+    for (size_t k = 0; k < 3; ++k) {
+      if (time_ - stamps_[triangle[k]] > kVertexCacheSize) {
+        stamps_[triangle[k]] = time_++;
+        ++misses;
+      }
+    }
+    return misses;
+  }
+
+  void Flush() { time_ += kVertexCacheSize + 1; }
+
+ private:
+  std::vector<size_t> stamps_;
+  size_t time_;
+};
+
+/**
+ * @brief The Cluster struct Run of consecutive triangles that is moved as a
+ * whole by OverdrawRange.
+ */
+struct Cluster {
+  size_t begin;
+  size_t end;
+  float sort_key;
+};
+
+/**
+ * @brief OverdrawRange Splits the triangles of a range into clusters and
+ * sorts them by how much they face away from the centroid of the range.
+ */
+void OverdrawRange(const std::vector<float> &vertices, float threshold,
+                   int *indices, size_t triangles, FifoCache *cache) {
+  if (triangles == 0) return;
+
+  cache->Flush();
+  size_t misses = 0;
+  for (size_t t = 0; t < triangles; ++t)
+    misses += cache->Access(indices + 3 * t);
+  const double kMaxAcmr = threshold * static_cast<double>(misses) / triangles;
+
+  // A cluster ends as soon as restarting the cache after it costs no more
+  // than the threshold allows.
+  std::vector<Cluster> clusters;
+  cache->Flush();
+  size_t begin = 0;
+  misses = 0;
+  for (size_t t = 0; t < triangles; ++t) {
+    misses += cache->Access(indices + 3 * t);
+    if (misses <= kMaxAcmr * (t + 1 - begin) || t + 1 == triangles) {
+      clusters.push_back({begin, t + 1, 0.0f});
+      begin = t + 1;
+      misses = 0;
+      cache->Flush();
+    }
+  }
+  if (clusters.size() < 2) return;
+
+  // Twice the area weighted centroids and normals, of the clusters and of the
+  // whole range.
+  std::vector<glm::vec3> centroids(clusters.size()), normals(clusters.size());
+  std::vector<float> areas(clusters.size(), 0.0f);
+  glm::vec3 range_centroid(0.0f);
+  float range_area = 0.0f;
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    glm::vec3 centroid(0.0f), normal(0.0f);
+    float area = 0.0f;
+    for (size_t t = clusters[c].begin; t < clusters[c].end; ++t) {
+      glm::vec3 p[3];
+      for (size_t k = 0; k < 3; ++k) {
+        const float *kVertex = &vertices[3 * indices[3 * t + k]];
+        p[k] = glm::vec3(kVertex[0], kVertex[1], kVertex[2]);
+      }
+      const glm::vec3 kNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+      const float kArea = glm::length(kNormal);
+      centroid += (p[0] + p[1] + p[2]) * (kArea / 3.0f);
+      normal += kNormal;
+      area += kArea;
+    }
+    centroids[c] = centroid;
+    normals[c] = normal;
+    areas[c] = area;
+    range_centroid += centroid;
+    range_area += area;
+  }
+  if (range_area > 0.0f) range_centroid /= range_area;
+
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    const float kLength = glm::length(normals[c]);
+    if (areas[c] <= 0.0f || kLength <= 0.0f) continue;
+    clusters[c].sort_key = glm::dot(centroids[c] / areas[c] - range_centroid,
+                                    normals[c] / kLength);
+  }
+
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const Cluster &a, const Cluster &b) {
+                     return a.sort_key > b.sort_key;
+                   });
+
+  std::vector<int> output;
+  output.reserve(triangles * 3);
+  for (const Cluster &cluster : clusters)
+    output.insert(output.end(), indices + 3 * cluster.begin,
+                  indices + 3 * cluster.end);
+  std::copy(output.begin(), output.end(), indices);
+}
+
+const size_t kMinVerticesPerThread = 1 << 15;
+
+/**
+ * @brief PermuteVertices Moves every vertex v, with all of its attributes, to
+ * remap[v].
+ */
+void PermuteVertices(const std::vector<int> &remap, TriangleMesh *mesh) {
+  const size_t kVertices = remap.size();
+  auto permute = [&](size_t components, std::vector<float> *values) {
+    if (values->size() != kVertices * components) return;
+    std::vector<float> permuted(values->size());
+    ParallelFor(kVertices, kMinVerticesPerThread,
+                [&](size_t begin, size_t end) {
+      for (size_t v = begin; v < end; ++v)
+        for (size_t j = 0; j < components; ++j)
+          permuted[remap[v] * components + j] = (*values)[v * components + j];
+    });
+    values->swap(permuted);
+  };
+  permute(3, &mesh->vertices_);
+  permute(3, &mesh->normals_);
+  permute(2, &mesh->texCoords_);
+  PermuteVertexStreams(remap, kVertices, &mesh->streams_);
+}
+
+/**
+ * @brief kMortonLevels Levels of the Z-order curve, quantization steps per
+ * axis being 2^kMortonLevels.
+ */
+const int kMortonLevels = 10;
+
+/**
+ * @brief The MortonEntry struct A vertex or triangle keyed by its position
+ * along the Z-order curve.
+ */
+struct MortonEntry {
+  uint32_t key;
+  uint32_t index;
+};
+
+/**
+ * @brief SpreadBits Inserts two zero bits above each of the kMortonLevels
+ * lowest bits of x.
+ */
+uint32_t SpreadBits(uint32_t x) {
+  x &= (1u << kMortonLevels) - 1;
+  x = (x | (x << 16)) & 0x030000FF;
+  x = (x | (x << 8)) & 0x0300F00F;
+  x = (x | (x << 4)) & 0x030C30C3;
+  x = (x | (x << 2)) & 0x09249249;
+  return x;
+}
+
+/**
+ * @brief The MortonEncoder class Position of a point along the Z-order curve
+ * through the bounding box of a mesh.
+ */
+class MortonEncoder {
+ public:
+  explicit MortonEncoder(const TriangleMesh &mesh) : min_(mesh.min_) {
+    const glm::vec3 kExtent = mesh.max_ - mesh.min_;
+    const float kSteps = static_cast<float>((1 << kMortonLevels) - 1);
+    for (int j = 0; j < 3; ++j)
+      scale_[j] = kExtent[j] > 0.0f ? kSteps / kExtent[j] : 0.0f;
+  }
+
+  uint32_t Code(const glm::vec3 &point) const {
+    const float kSteps = static_cast<float>((1 << kMortonLevels) - 1);
+    uint32_t code = 0;
+    for (int j = 0; j < 3; ++j) {
+      const float kStep = std::min(
+          std::max((point[j] - min_[j]) * scale_[j], 0.0f), kSteps);
+      code |= SpreadBits(static_cast<uint32_t>(kStep)) << j;
+    }
+    return code;
+  }
+
+ private:
+  glm::vec3 min_;
+  glm::vec3 scale_;
+};
+
+}  // namespace
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<int> &faces) {
+  VertexCacheStats stats = {0.0, 0.0};
+  if (faces.empty()) return stats;
+
+  const int kMaxVertex = *std::max_element(faces.begin(), faces.end());
+  std::vector<char> referenced(static_cast<size_t>(kMaxVertex) + 1, 0);
+  std::deque<int> cache;
+  size_t misses = 0;
+  for (int index : faces) {
+    referenced[index] = 1;
+    if (std::find(cache.begin(), cache.end(), index) != cache.end()) continue;
+    ++misses;
+    cache.push_back(index);
+    if (cache.size() > kVertexCacheSize) cache.pop_front();
+  }
+
+  const size_t kReferenced =
+      std::count(referenced.begin(), referenced.end(), 1);
+  stats.acmr = static_cast<double>(misses) / (faces.size() / 3);
+  stats.atvr = static_cast<double>(misses) / kReferenced;
+  return stats;
+}
+
+void OptimizeVertexCache(TriangleMesh *mesh) {
+  const size_t kVertices = mesh->vertices_.size() / 3;
+  std::vector<int> local_of(kVertices, -1);
+  auto optimize = [&](std::vector<int> *faces,
+                      const std::vector<Submesh> &submeshes) {
+    for (const auto &range : TriangleRanges(*faces, submeshes))
+      TipsifyLocalRange(faces->data() + range.first * 3,
+                        range.second - range.first, &local_of);
+  };
+
+  // When a single range spans faces_, the adjacency cached on the mesh
+  // already numbers its vertices.
+  const size_t kTriangles = mesh->faces_.size() / 3;
+  const auto kRanges = TriangleRanges(mesh->faces_, mesh->submeshes_);
+  if (kTriangles > 0 && kRanges.size() == 1 && kRanges[0].first == 0 &&
+      kRanges[0].second == kTriangles) {
+    TipsifyRange(mesh->faces_.data(), kTriangles, mesh->faces_.data(),
+                 kVertices, mesh->VertexCorners());
+  } else {
+    optimize(&mesh->faces_, mesh->submeshes_);
+  }
+  for (auto &lod : mesh->lods_) optimize(&lod.faces, lod.submeshes);
+  mesh->meshlets_.clear();
+  mesh->InvalidateAdjacency();
+}
+
+void OptimizeOverdraw(TriangleMesh *mesh, float threshold) {
+  FifoCache cache(mesh->vertices_.size() / 3);
+  auto optimize = [&](std::vector<int> *faces,
+                      const std::vector<Submesh> &submeshes) {
+    for (const auto &range : TriangleRanges(*faces, submeshes))
+      OverdrawRange(mesh->vertices_, threshold,
+                    faces->data() + range.first * 3,
+                    range.second - range.first, &cache);
+  };
+  optimize(&mesh->faces_, mesh->submeshes_);
+  for (auto &lod : mesh->lods_) optimize(&lod.faces, lod.submeshes);
+  mesh->meshlets_.clear();
+  mesh->InvalidateAdjacency();
+}
+
+void OptimizeVertexFetch(TriangleMesh *mesh) {
+  const size_t kVertices = mesh->vertices_.size() / 3;
+  std::vector<int> remap(kVertices, -1);
+  int next = 0;
+  for (int &index : mesh->faces_) {
+    if (remap[index] < 0) remap[index] = next++;
+    index = remap[index];
+  }
+  for (size_t v = 0; v < kVertices; ++v)
+    if (remap[v] < 0) remap[v] = next++;
+  for (auto &lod : mesh->lods_)
+    for (int &index : lod.faces) index = remap[index];
+
+  PermuteVertices(remap, mesh);
+  mesh->InvalidateAdjacency();
+}
+
+void SpatialSort(TriangleMesh *mesh) {
+  const size_t kVertices = mesh->vertices_.size() / 3;
+  if (kVertices == 0) return;
+  const MortonEncoder kEncoder(*mesh);
+
+  std::vector<MortonEntry> vertices(kVertices);
+  ParallelFor(kVertices, kMinVerticesPerThread, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      const float *kPosition = &mesh->vertices_[v * 3];
+      vertices[v].key = kEncoder.Code(
+          glm::vec3(kPosition[0], kPosition[1], kPosition[2]));
+      vertices[v].index = static_cast<uint32_t>(v);
+    }
+  });
+  RadixSort(32, &vertices);
+
+  std::vector<int> remap(kVertices);
+  ParallelFor(kVertices, kMinVerticesPerThread, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      remap[vertices[i].index] = static_cast<int>(i);
+  });
+  std::vector<MortonEntry>().swap(vertices);
+  auto renumber = [&](std::vector<int> *faces) {
+    ParallelFor(faces->size(), kMinVerticesPerThread,
+                [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) (*faces)[i] = remap[(*faces)[i]];
+    });
+  };
+  renumber(&mesh->faces_);
+  for (auto &lod : mesh->lods_) renumber(&lod.faces);
+  PermuteVertices(remap, mesh);
+
+  // Triangles follow the curve through their lowest-ranked vertex, within
+  // their range. The new index of a vertex is its rank along the curve, so
+  // the smallest index of a triangle is that vertex, which saves gathering
+  // the positions of the triangles in their old, scattered order.
+  const int kVertexBits = RadixSortBits(kVertices - 1);
+  auto sort_triangles = [&](std::vector<int> *faces,
+                            const std::vector<Submesh> &submeshes) {
+    for (const auto &range : TriangleRanges(*faces, submeshes)) {
+      const size_t kTriangles = range.second - range.first;
+      int *indices = faces->data() + range.first * 3;
+      std::vector<MortonEntry> triangles(kTriangles);
+      ParallelFor(kTriangles, kMinVerticesPerThread,
+                  [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+          const int *kFace = indices + t * 3;
+          triangles[t].key = static_cast<uint32_t>(
+              std::min(kFace[0], std::min(kFace[1], kFace[2])));
+          triangles[t].index = static_cast<uint32_t>(t);
+        }
+      });
+      RadixSort(kVertexBits, &triangles);
+
+      std::vector<int> sorted(kTriangles * 3);
+      ParallelFor(kTriangles, kMinVerticesPerThread,
+                  [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t)
+          std::copy(indices + triangles[t].index * 3,
+                    indices + triangles[t].index * 3 + 3,
+                    sorted.begin() + t * 3);
+      });
+      std::copy(sorted.begin(), sorted.end(), indices);
+    }
+  };
+  sort_triangles(&mesh->faces_, mesh->submeshes_);
+  for (auto &lod : mesh->lods_) sort_triangles(&lod.faces, lod.submeshes);
+  mesh->meshlets_.clear();
+  mesh->InvalidateAdjacency();
+}
+
+}  // namespace data_representation
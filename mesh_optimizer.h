@@ -0,0 +1,103 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef MESH_OPTIMIZER_H_
+#define MESH_OPTIMIZER_H_
+
+#include <triangle_mesh.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief kVertexCacheSize Size of the FIFO post-transform cache that the
+ * optimization targets and the analysis simulates.
+ */
+const size_t kVertexCacheSize = 16;
+
+/**
+ * @brief The VertexCacheStats struct Efficiency of an index buffer on a FIFO
+ * post-transform vertex cache.
+ */
+struct VertexCacheStats {
+  /**
+   * @brief acmr Average cache miss ratio: transformed vertices per triangle.
+   * 0.5 is the optimum for large regular meshes and 3 the worst case.
+   */
+  double acmr;
+
+  /**
+   * @brief atvr Average transform to vertex ratio: transformed vertices per
+   * referenced vertex. 1 is the optimum.
+   */
+  double atvr;
+};
+
+/**
+ * @brief AnalyzeVertexCache Simulates a FIFO vertex cache of
+ * kVertexCacheSize entries over the index buffer.
+ * @param faces Three vertex indices per triangle.
+ * @return The cache statistics, zero for an empty buffer.
+ */
+VertexCacheStats AnalyzeVertexCache(const std::vector<int> &faces);
+
+/**
+ * @brief OptimizeVertexCache Reorders the triangles of faces_ for
+ * post-transform cache locality with the Tipsify algorithm (Sander et al.
+ * 2007). Every submesh range is optimized on its own so submeshes stay
+ * contiguous. The levels of detail in lods_ are optimized too. A single
+ * range spanning faces_ uses the adjacency cached on the mesh. Drops the
+ * meshlets and invalidates the adjacency of the mesh.
+ * @param mesh The mesh to reorder.
+ */
+void OptimizeVertexCache(TriangleMesh *mesh);
+
+/**
+ * @brief kOverdrawThreshold Default ACMR increase, relative to the input
+ * order, allowed by OptimizeOverdraw.
+ */
+const float kOverdrawThreshold = 1.05f;
+
+/**
+ * @brief OptimizeOverdraw Reorders the triangles of faces_ to reduce overdraw
+ * from any view direction (Sander et al. 2007). The triangles are split into
+ * clusters wherever the vertex cache would not suffer from a restart, and the
+ * clusters are sorted so that those facing away from the centroid of the
+ * submesh, which tend to occlude the others, are drawn first. It is meant to
+ * run after OptimizeVertexCache. Every submesh range is reordered on its own,
+ * as are the levels of detail. Drops the meshlets and invalidates the
+ * adjacency of the mesh.
+ * @param mesh The mesh to reorder.
+ * @param threshold Maximum ACMR of a cluster relative to the ACMR of its
+ * submesh. Larger values give smaller clusters and less overdraw.
+ */
+void OptimizeOverdraw(TriangleMesh *mesh,
+                      float threshold = kOverdrawThreshold);
+
+/**
+ * @brief OptimizeVertexFetch Renumbers the vertices in order of first use in
+ * faces_, so that vertex fetches follow the index buffer through memory.
+ * Unreferenced vertices are kept at the end, and the levels of detail are
+ * renumbered accordingly. Invalidates the adjacency of the mesh.
+ * @param mesh The mesh to reorder.
+ */
+void OptimizeVertexFetch(TriangleMesh *mesh);
+
+/**
+ * @brief SpatialSort Reorders the vertices, and the triangles of every submesh
+ * range, along the Z-order curve through the bounding box, so that elements
+ * close in space are close in memory. The vertices are sorted by 30-bit
+ * Morton codes, and the triangles by their vertex that comes first along the
+ * curve, both with parallel radix sorts. The levels of detail are renumbered
+ * and sorted too. Later passes that reorder the vertices, like
+ * OptimizeVertexFetch, replace the vertex order, but start from spatially
+ * coherent triangles. Drops the meshlets and invalidates the adjacency of the
+ * mesh.
+ * @param mesh The mesh to reorder, with its bounding box.
+ */
+void SpatialSort(TriangleMesh *mesh);
+
+}  // namespace data_representation
+
+#endif  // MESH_OPTIMIZER_H_
@@ -0,0 +1,428 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <mesh_simplifier.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./mesh_adjacency.h"
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kMinLodReduction Fraction of the triangles of the previous level
+ * that a level has to remove to be kept.
+ */
+const float kMinLodReduction = 0.2f;
+
+/**
+ * @brief The Quadric struct Area weighted sum of the squared distances to the
+ * planes of a set of triangles, as a symmetric 4x4 matrix.
+ */
+struct Quadric {
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+  /**
+   * @brief weight Sum of the areas of the triangles.
+   */
+  double weight;
+
+  void Add(const Quadric &q) {
+    a2 += q.a2;
+    ab += q.ab;
+    ac += q.ac;
+    ad += q.ad;
+    b2 += q.b2;
+    bc += q.bc;
+    bd += q.bd;
+    c2 += q.c2;
+    cd += q.cd;
+    d2 += q.d2;
+    weight += q.weight;
+  }
+};
+
+/**
+ * @brief CollapseCost Mean squared distance from p to the planes of two
+ * quadrics.
+ */
+double CollapseCost(const Quadric &q0, const Quadric &q1, const glm::vec3 &p) {
+  const double kWeight = q0.weight + q1.weight;
+  if (kWeight <= 0.0) return 0.0;
+  const double x = p.x, y = p.y, z = p.z;
+  const double kA2 = q0.a2 + q1.a2, kAb = q0.ab + q1.ab, kAc = q0.ac + q1.ac;
+  const double kAd = q0.ad + q1.ad, kB2 = q0.b2 + q1.b2, kBc = q0.bc + q1.bc;
+  const double kBd = q0.bd + q1.bd, kC2 = q0.c2 + q1.c2, kCd = q0.cd + q1.cd;
+  const double kD2 = q0.d2 + q1.d2;
+  const double kCost = kA2 * x * x + kB2 * y * y + kC2 * z * z +
+                       2.0 * (kAb * x * y + kAc * x * z + kBc * y * z) +
+                       2.0 * (kAd * x + kBd * y + kCd * z) + kD2;
+  return std::max(kCost, 0.0) / kWeight;
+}
+
+/**
+ * @brief VertexRing Sorted neighbours of a vertex, with every neighbour
+ * appearing once per triangle that holds the edge to it.
+ */
+void VertexRing(const std::vector<int> &faces, const CsrAdjacency &corners,
+                size_t vertex, std::vector<int> *ring) {
+  ring->clear();
+  for (const uint32_t *corner = corners.Begin(vertex);
+       corner != corners.End(vertex); ++corner) {
+    const size_t kTriangle = *corner / 3;
+    const size_t kK = *corner % 3;
+    ring->push_back(faces[kTriangle * 3 + (kK + 1) % 3]);
+    ring->push_back(faces[kTriangle * 3 + (kK + 2) % 3]);
+  }
+  std::sort(ring->begin(), ring->end());
+}
+
+/**
+ * @brief IsManifoldInterior Whether the edges of a vertex are each shared by
+ * exactly two of its triangles.
+ */
+bool IsManifoldInterior(size_t vertex, const std::vector<int> &ring) {
+  if (ring.empty()) return false;
+  for (size_t i = 0; i < ring.size(); i += 2) {
+    if (ring[i] == static_cast<int>(vertex) || i + 1 == ring.size() ||
+        ring[i] != ring[i + 1])
+      return false;
+    if (i + 2 < ring.size() && ring[i + 2] == ring[i]) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief The Simplifier class State of the simplification of a mesh, kept
+ * between levels so that quadrics and errors are relative to the full mesh.
+ */
+class Simplifier {
+ public:
+  Simplifier(const TriangleMesh &mesh, const CsrAdjacency &vertex_corners);
+
+  size_t triangle_count() const { return faces_.size() / 3; }
+  float error() const { return error_; }
+
+  /**
+   * @brief Simplify Collapses edges until at most target triangles are left,
+   * or no collapse under the error limit remains.
+   */
+  void Simplify(size_t target, float max_error);
+
+  /**
+   * @brief Snapshot The current faces as a level of detail.
+   */
+  MeshLod Snapshot(const TriangleMesh &mesh) const;
+
+ private:
+  /**
+   * @brief Pass Applies non overlapping collapses, at most goal of them.
+   * @return The number of collapses applied.
+   */
+  size_t Pass(size_t goal, double max_cost);
+
+  /**
+   * @brief FindCollapses Cheapest valid collapse of every free vertex.
+   */
+  void FindCollapses(double max_cost);
+
+  /**
+   * @brief IsValidCollapse Whether moving vertex onto its neighbour target
+   * keeps the surface manifold and does not flip any triangle.
+   * @param ring The sorted, unique neighbours of vertex.
+   * @param target_ring Scratch vector.
+   */
+  bool IsValidCollapse(int vertex, int target, const std::vector<int> &ring,
+                       std::vector<int> *target_ring) const;
+
+  /**
+   * @brief Compact Drops the degenerate triangles keeping every submesh
+   * contiguous.
+   */
+  void Compact();
+
+  size_t vertex_count_;
+  std::vector<glm::vec3> points_;
+  std::vector<Quadric> quadrics_;
+  std::vector<int> faces_;
+
+  /**
+   * @brief ranges_ First and end triangle of every submesh, or of the whole
+   * mesh.
+   */
+  std::vector<std::pair<size_t, size_t>> ranges_;
+
+  /**
+   * @brief locked_ Boundary and non-manifold vertices, found on the first
+   * pass.
+   */
+  std::vector<char> locked_;
+  CsrAdjacency corners_;
+
+  /**
+   * @brief targets_ Vertex onto which every vertex collapses at the lowest
+   * cost, -1 if none, and costs_ that cost. Only the dirty_ vertices are
+   * updated on every pass.
+   */
+  std::vector<int> targets_;
+  std::vector<double> costs_;
+  std::vector<char> dirty_;
+  float error_;
+};
+
+Simplifier::Simplifier(const TriangleMesh &mesh,
+                       const CsrAdjacency &vertex_corners)
+    : vertex_count_(mesh.vertices_.size() / 3),
+      points_(vertex_count_),
+      faces_(mesh.faces_),
+      targets_(vertex_count_, -1),
+      costs_(vertex_count_, 0.0),
+      dirty_(vertex_count_, 1),
+      error_(0.0f) {
+  // Positions relative to the longest edge make errors independent of scale.
+  const glm::vec3 kExtent = mesh.max_ - mesh.min_;
+  const float kLongest = std::max(kExtent.x, std::max(kExtent.y, kExtent.z));
+  const float kScale = kLongest > 0.0f ? 1.0f / kLongest : 1.0f;
+  ParallelFor(vertex_count_, 1 << 15, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v)
+      points_[v] = (glm::vec3(mesh.vertices_[3 * v], mesh.vertices_[3 * v + 1],
+                              mesh.vertices_[3 * v + 2]) -
+                    mesh.min_) *
+                   kScale;
+  });
+
+  for (const auto &submesh : mesh.submeshes_)
+    ranges_.push_back(std::make_pair(submesh.first / 3,
+                                     (submesh.first + submesh.count) / 3));
+  if (ranges_.empty()) ranges_.push_back(std::make_pair(0, triangle_count()));
+
+  // The first pass starts from the faces of the mesh, so it can use the
+  // adjacency the mesh caches. Later passes rebuild it for their own faces.
+  corners_ = vertex_corners;
+  quadrics_.assign(vertex_count_, Quadric());
+  ParallelFor(vertex_count_, 1 << 14, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      Quadric &q = quadrics_[v];
+      for (const uint32_t *corner = corners_.Begin(v);
+           corner != corners_.End(v); ++corner) {
+        const int *kFace = &faces_[*corner / 3 * 3];
+        const glm::vec3 &kP0 = points_[kFace[0]];
+        const glm::vec3 kNormal =
+            glm::cross(points_[kFace[1]] - kP0, points_[kFace[2]] - kP0);
+        const double kLength = glm::length(kNormal);
+        if (kLength <= 0.0) continue;
+        const double kNx = kNormal.x / kLength, kNy = kNormal.y / kLength,
+                     kNz = kNormal.z / kLength;
+        const double kD = -(kNx * kP0.x + kNy * kP0.y + kNz * kP0.z);
+        // The area of the triangle, a third of it for every corner.
+        const double kW = kLength / 6.0;
+        q.a2 += kW * kNx * kNx;
+        q.ab += kW * kNx * kNy;
+        q.ac += kW * kNx * kNz;
+        q.ad += kW * kNx * kD;
+        q.b2 += kW * kNy * kNy;
+        q.bc += kW * kNy * kNz;
+        q.bd += kW * kNy * kD;
+        q.c2 += kW * kNz * kNz;
+        q.cd += kW * kNz * kD;
+        q.d2 += kW * kD * kD;
+        q.weight += kW;
+      }
+    }
+  });
+
+  locked_.assign(vertex_count_, 0);
+  ParallelFor(vertex_count_, 1 << 14, [&](size_t begin, size_t end) {
+    std::vector<int> ring;
+    for (size_t v = begin; v < end; ++v) {
+      VertexRing(faces_, corners_, v, &ring);
+      locked_[v] = !IsManifoldInterior(v, ring);
+    }
+  });
+}
+
+bool Simplifier::IsValidCollapse(int vertex, int target,
+                                 const std::vector<int> &ring,
+                                 std::vector<int> *target_ring) const {
+  // Link condition: the edge must have exactly two opposite vertices,
+  // otherwise the collapse would pinch the surface.
+  VertexRing(faces_, corners_, target, target_ring);
+  target_ring->erase(std::unique(target_ring->begin(), target_ring->end()),
+                     target_ring->end());
+  size_t shared = 0;
+  for (int neighbor : *target_ring)
+    if (std::binary_search(ring.begin(), ring.end(), neighbor)) ++shared;
+  if (shared != 2) return false;
+
+  // The triangles that move must keep their orientation.
+  for (const uint32_t *corner = corners_.Begin(vertex);
+       corner != corners_.End(vertex); ++corner) {
+    const size_t kTriangle = *corner / 3;
+    const size_t kK = *corner % 3;
+    const int kB = faces_[kTriangle * 3 + (kK + 1) % 3];
+    const int kC = faces_[kTriangle * 3 + (kK + 2) % 3];
+    if (kB == target || kC == target) continue;
+    const glm::vec3 kEdge = points_[kC] - points_[kB];
+    const glm::vec3 kBefore = glm::cross(kEdge, points_[vertex] - points_[kB]);
+    const glm::vec3 kAfter = glm::cross(kEdge, points_[target] - points_[kB]);
+    if (glm::dot(kBefore, kAfter) <=
+        0.25f * glm::length(kBefore) * glm::length(kAfter))
+      return false;
+  }
+  return true;
+}
+
+void Simplifier::FindCollapses(double max_cost) {
+  ParallelFor(vertex_count_, 1 << 12, [&](size_t begin, size_t end) {
+    std::vector<int> ring, target_ring;
+    std::vector<std::pair<double, int>> candidates;
+    for (size_t v = begin; v < end; ++v) {
+      if (!dirty_[v]) continue;
+      dirty_[v] = 0;
+      targets_[v] = -1;
+      if (locked_[v] || corners_.Count(v) == 0) continue;
+      VertexRing(faces_, corners_, v, &ring);
+      ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+
+      // Validity is checked in order of cost, so usually only once.
+      candidates.clear();
+      for (int target : ring) {
+        const double kCost =
+            CollapseCost(quadrics_[v], quadrics_[target], points_[target]);
+        if (kCost <= max_cost)
+          candidates.push_back(std::make_pair(kCost, target));
+      }
+      std::sort(candidates.begin(), candidates.end());
+      for (const auto &candidate : candidates) {
+        if (!IsValidCollapse(static_cast<int>(v), candidate.second, ring,
+                             &target_ring))
+          continue;
+        targets_[v] = candidate.second;
+        costs_[v] = candidate.first;
+        break;
+      }
+    }
+  });
+}
+
+size_t Simplifier::Pass(size_t goal, double max_cost) {
+  FindCollapses(max_cost);
+
+  std::vector<int> order;
+  for (size_t v = 0; v < vertex_count_; ++v)
+    if (targets_[v] >= 0) order.push_back(static_cast<int>(v));
+  auto cheaper = [this](int a, int b) { return costs_[a] < costs_[b]; };
+  // Only the cheapest candidates can be applied in this pass; about half of
+  // them are rejected because their neighbourhoods overlap.
+  const size_t kSorted = std::min(order.size(), 2 * goal);
+  std::nth_element(order.begin(), order.begin() + kSorted, order.end(),
+                   cheaper);
+  std::sort(order.begin(), order.begin() + kSorted, cheaper);
+
+  std::vector<char> touched(vertex_count_, 0);
+  std::vector<int> remap(vertex_count_, -1);
+  std::vector<int> ring;
+  size_t collapses = 0;
+  for (size_t i = 0; i < kSorted && collapses < goal; ++i) {
+    const int kVertex = order[i];
+    const int kTarget = targets_[kVertex];
+    if (touched[kVertex] || touched[kTarget]) continue;
+
+    // Collapses whose rings overlap this one would have been checked against
+    // stale triangles.
+    touched[kVertex] = 1;
+    VertexRing(faces_, corners_, kVertex, &ring);
+    for (int neighbor : ring) touched[neighbor] = 1;
+
+    // The candidates of the vertices around both ends change.
+    dirty_[kVertex] = 1;
+    for (int neighbor : ring) dirty_[neighbor] = 1;
+    VertexRing(faces_, corners_, kTarget, &ring);
+    for (int neighbor : ring) dirty_[neighbor] = 1;
+
+    remap[kVertex] = kTarget;
+    quadrics_[kTarget].Add(quadrics_[kVertex]);
+    error_ = std::max(error_, static_cast<float>(std::sqrt(costs_[kVertex])));
+    ++collapses;
+  }
+  if (collapses == 0) return 0;
+
+  ParallelFor(faces_.size(), 1 << 16, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      if (remap[faces_[i]] >= 0) faces_[i] = remap[faces_[i]];
+  });
+  Compact();
+  BuildVertexCorners(faces_, vertex_count_, &corners_);
+  return collapses;
+}
+
+void Simplifier::Compact() {
+  size_t out = 0;
+  for (auto &range : ranges_) {
+    const size_t kFirst = out;
+    for (size_t t = range.first; t < range.second; ++t) {
+      const int *kFace = &faces_[3 * t];
+      if (kFace[0] == kFace[1] || kFace[1] == kFace[2] || kFace[2] == kFace[0])
+        continue;
+      std::copy(kFace, kFace + 3, &faces_[3 * out]);
+      ++out;
+    }
+    range = std::make_pair(kFirst, out);
+  }
+  faces_.resize(3 * out);
+}
+
+void Simplifier::Simplify(size_t target, float max_error) {
+  const double kMaxCost = static_cast<double>(max_error) * max_error;
+  while (triangle_count() > target) {
+    // Every collapse of an interior vertex removes two triangles.
+    const size_t kGoal = std::max<size_t>(1, (triangle_count() - target) / 2);
+    if (Pass(kGoal, kMaxCost) == 0) break;
+  }
+}
+
+MeshLod Simplifier::Snapshot(const TriangleMesh &mesh) const {
+  MeshLod lod;
+  lod.faces = faces_;
+  lod.error = error_;
+  for (size_t s = 0; s < mesh.submeshes_.size(); ++s) {
+    Submesh submesh = mesh.submeshes_[s];
+    submesh.first = static_cast<unsigned>(3 * ranges_[s].first);
+    submesh.count =
+        static_cast<unsigned>(3 * (ranges_[s].second - ranges_[s].first));
+    lod.submeshes.push_back(submesh);
+  }
+  return lod;
+}
+
+}  // namespace
+
+void GenerateLods(TriangleMesh *mesh, size_t lod_count, float max_error,
+                  LoadProfile *profile) {
+  mesh->lods_.clear();
+  if (lod_count == 0 || mesh->faces_.empty()) return;
+
+  Simplifier simplifier(*mesh, mesh->VertexCorners());
+  for (size_t level = 1; level <= lod_count; ++level) {
+    ScopedStage stage(profile,
+                      "lod " + std::to_string(level) + " simplification");
+    const size_t kPrevious = simplifier.triangle_count();
+    simplifier.Simplify(static_cast<size_t>(kPrevious * kLodReduction),
+                        max_error);
+    if (simplifier.triangle_count() > kPrevious * (1.0f - kMinLodReduction))
+      break;
+    mesh->lods_.push_back(simplifier.Snapshot(*mesh));
+    stage.set_bytes(sizeof(int) * mesh->lods_.back().faces.size());
+  }
+}
+
+}  // namespace data_representation
@@ -0,0 +1,50 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef MESH_SIMPLIFIER_H_
+#define MESH_SIMPLIFIER_H_
+
+#include <load_profile.h>
+#include <triangle_mesh.h>
+
+#include <cstddef>
+
+namespace data_representation {
+
+/**
+ * @brief kLodReduction Target triangle count of every level of detail
+ * relative to the previous one.
+ */
+const float kLodReduction = 0.25f;
+
+/**
+ * @brief kMaxLodError Default limit of the geometric error of the levels of
+ * detail, relative to the longest edge of the bounding box.
+ */
+const float kMaxLodError = 0.05f;
+
+/**
+ * @brief GenerateLods Builds a chain of levels of detail into lods_ with
+ * quadric error metric simplification (Garland and Heckbert 1997). Every
+ * pass computes in parallel the cheapest collapse of each vertex onto one of
+ * its neighbours, then applies the cheapest ones whose neighbourhoods do not
+ * overlap. Vertices only move onto existing ones, so the levels index the
+ * vertices of the mesh and need no vertex data of their own. Boundary and
+ * non-manifold vertices, which include texture seams, never move, collapses
+ * that would flip a triangle or change the topology are rejected, and every
+ * submesh keeps a contiguous range of faces.
+ * The chain stops early when the error limit is reached or a level would not
+ * remove at least a fifth of the triangles of the previous one.
+ * @param mesh The mesh, with bounding box. lods_ is replaced. The first
+ * level starts from the adjacency cached on the mesh, see
+ * TriangleMesh::VertexCorners.
+ * @param lod_count The maximum number of levels, not counting the full mesh.
+ * @param max_error The limit of the error of the levels.
+ * @param profile If not null, receives the timing of every level.
+ */
+void GenerateLods(TriangleMesh *mesh, size_t lod_count,
+                  float max_error = kMaxLodError,
+                  LoadProfile *profile = nullptr);
+
+}  // namespace data_representation
+
+#endif  // MESH_SIMPLIFIER_H_
@@ -0,0 +1,182 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <meshlet.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kMeshletConeSpread Smallest cosine between the normal of a triangle
+ * and the axis of a meshlet with kMinMeshletTriangles triangles or more that
+ * lets it join the meshlet.
+ */
+const float kMeshletConeSpread = 0.5f;
+
+/**
+ * @brief kNoCone Cutoff of the meshlets whose normals do not fit in a cone.
+ */
+const float kNoCone = 2.0f;
+
+glm::vec3 Position(const std::vector<float> &vertices, int index) {
+  return glm::vec3(vertices[3 * index], vertices[3 * index + 1],
+                   vertices[3 * index + 2]);
+}
+
+/**
+ * @brief MeshletBounds Bounding sphere of the vertices and normal cone of the
+ * triangles of a meshlet.
+ */
+void MeshletBounds(const TriangleMesh &mesh,
+                   const std::vector<glm::vec3> &normals, Meshlet *meshlet) {
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(std::numeric_limits<float>::lowest());
+  glm::vec3 axis(0.0f);
+  for (size_t i = meshlet->first; i < meshlet->first + meshlet->count; ++i) {
+    const glm::vec3 kP = Position(mesh.vertices_, mesh.faces_[i]);
+    min = glm::min(min, kP);
+    max = glm::max(max, kP);
+    if (i % 3 == 0) axis += normals[i / 3];
+  }
+
+  meshlet->center = (min + max) * 0.5f;
+  float radius = 0.0f;
+  for (size_t i = meshlet->first; i < meshlet->first + meshlet->count; ++i)
+    radius = std::max(radius, glm::length(Position(mesh.vertices_,
+                                                   mesh.faces_[i]) -
+                                          meshlet->center));
+  meshlet->radius = radius;
+
+  const float kLength = glm::length(axis);
+  meshlet->cone_axis = kLength > 0.0f ? axis / kLength : glm::vec3(0.0f);
+  meshlet->cone_cutoff = kNoCone;
+  if (kLength <= 0.0f) return;
+  float min_dot = 1.0f;
+  for (size_t t = meshlet->first / 3; t < (meshlet->first + meshlet->count) / 3;
+       ++t)
+    if (normals[t] != glm::vec3(0.0f))
+      min_dot = std::min(min_dot, glm::dot(normals[t], meshlet->cone_axis));
+  if (min_dot >= 0.0f)
+    meshlet->cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+}  // namespace
+
+void BuildMeshlets(TriangleMesh *mesh) {
+  mesh->meshlets_.clear();
+  const size_t kTriangles = mesh->faces_.size() / 3;
+  std::vector<glm::vec3> normals(kTriangles);
+  ParallelFor(kTriangles, 1 << 14, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      const glm::vec3 kP0 = Position(mesh->vertices_, mesh->faces_[3 * t]);
+      const glm::vec3 kNormal =
+          glm::cross(Position(mesh->vertices_, mesh->faces_[3 * t + 1]) - kP0,
+                     Position(mesh->vertices_, mesh->faces_[3 * t + 2]) - kP0);
+      const float kLength = glm::length(kNormal);
+      normals[t] = kLength > 0.0f ? kNormal / kLength : glm::vec3(0.0f);
+    }
+  });
+
+  std::vector<std::pair<size_t, size_t>> ranges;
+  for (const auto &submesh : mesh->submeshes_)
+    ranges.push_back(std::make_pair(submesh.first / 3,
+                                    (submesh.first + submesh.count) / 3));
+  if (ranges.empty()) ranges.push_back(std::make_pair(0, kTriangles));
+
+  for (const auto &range : ranges) {
+    size_t begin = range.first;
+    glm::vec3 axis(0.0f);
+    for (size_t t = range.first; t < range.second; ++t) {
+      const size_t kCount = t - begin;
+      const float kLength = glm::length(axis);
+      if (kCount == kMaxMeshletTriangles ||
+          (kCount >= kMinMeshletTriangles && kLength > 0.0f &&
+           glm::dot(normals[t], axis) < kMeshletConeSpread * kLength)) {
+        mesh->meshlets_.push_back({static_cast<unsigned int>(3 * begin),
+                                   static_cast<unsigned int>(3 * kCount),
+                                   glm::vec3(0.0f), 0.0f, glm::vec3(0.0f),
+                                   kNoCone});
+        begin = t;
+        axis = glm::vec3(0.0f);
+      }
+      axis += normals[t];
+    }
+    if (range.second > begin)
+      mesh->meshlets_.push_back(
+          {static_cast<unsigned int>(3 * begin),
+           static_cast<unsigned int>(3 * (range.second - begin)),
+           glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), kNoCone});
+  }
+
+  ParallelFor(mesh->meshlets_.size(), 1 << 10, [&](size_t begin, size_t end) {
+    for (size_t m = begin; m < end; ++m)
+      MeshletBounds(*mesh, normals, &mesh->meshlets_[m]);
+  });
+}
+
+void CullMeshlets(const std::vector<Meshlet> &meshlets,
+                  const glm::mat4x4 &model_view_projection,
+                  const glm::vec3 &camera, bool frustum, bool backface,
+                  std::vector<char> *visible, MeshletCullStats *stats) {
+  // Planes of the frustum in model space, pointing inwards, as the sums and
+  // differences of the last row of the matrix with the others.
+  glm::vec4 planes[6];
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      planes[2 * i][j] =
+          model_view_projection[j][3] + model_view_projection[j][i];
+      planes[2 * i + 1][j] =
+          model_view_projection[j][3] - model_view_projection[j][i];
+    }
+  }
+  for (auto &plane : planes) {
+    const float kLength = glm::length(glm::vec3(plane));
+    if (kLength > 0.0f) plane /= kLength;
+  }
+
+  enum Outcome : char { kVisible, kFrustumCulled, kBackfaceCulled };
+  std::vector<char> outcomes(meshlets.size());
+  ParallelFor(meshlets.size(), 1 << 12, [&](size_t begin, size_t end) {
+    for (size_t m = begin; m < end; ++m) {
+      const Meshlet &kMeshlet = meshlets[m];
+      char outcome = kVisible;
+      for (int p = 0; frustum && p < 6 && outcome == kVisible; ++p)
+        if (glm::dot(glm::vec3(planes[p]), kMeshlet.center) + planes[p].w <
+            -kMeshlet.radius)
+          outcome = kFrustumCulled;
+      if (outcome == kVisible && backface) {
+        const glm::vec3 kToCenter = kMeshlet.center - camera;
+        if (glm::dot(kToCenter, kMeshlet.cone_axis) >=
+            kMeshlet.cone_cutoff * glm::length(kToCenter) + kMeshlet.radius)
+          outcome = kBackfaceCulled;
+      }
+      outcomes[m] = outcome;
+    }
+  });
+
+  visible->resize(meshlets.size());
+  *stats = MeshletCullStats{0, 0, 0, 0};
+  for (size_t m = 0; m < meshlets.size(); ++m) {
+    (*visible)[m] = outcomes[m] == kVisible;
+    if (outcomes[m] == kVisible) {
+      ++stats->visible;
+      stats->visible_triangles += meshlets[m].count / 3;
+    } else if (outcomes[m] == kFrustumCulled) {
+      ++stats->frustum_culled;
+    } else {
+      ++stats->backface_culled;
+    }
+  }
+}
+
+}  // namespace data_representation
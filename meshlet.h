@@ -0,0 +1,71 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef MESHLET_H_
+#define MESHLET_H_
+
+#include <triangle_mesh.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief kMaxMeshletTriangles Largest number of triangles of a meshlet.
+ */
+const size_t kMaxMeshletTriangles = 128;
+
+/**
+ * @brief kMinMeshletTriangles Number of triangles from which a meshlet is
+ * closed early if the next triangle would widen its normal cone too much.
+ */
+const size_t kMinMeshletTriangles = 64;
+
+/**
+ * @brief BuildMeshlets Partitions faces_ into meshlets_ by cutting every
+ * submesh range, in its current order, into runs of kMinMeshletTriangles to
+ * kMaxMeshletTriangles triangles. The vertex cache and overdraw orders keep
+ * consecutive triangles close and mostly facing the same way, so the runs
+ * are compact without reordering. The bounds are computed in parallel.
+ * @param mesh The mesh, after any pass that reorders faces_.
+ */
+void BuildMeshlets(TriangleMesh *mesh);
+
+/**
+ * @brief The MeshletCullStats struct Outcome of CullMeshlets.
+ */
+struct MeshletCullStats {
+  size_t visible;
+  size_t frustum_culled;
+  size_t backface_culled;
+
+  /**
+   * @brief visible_triangles Triangles of the visible meshlets.
+   */
+  size_t visible_triangles;
+};
+
+/**
+ * @brief CullMeshlets Tests the meshlets against the view frustum and their
+ * normal cones against the camera position, in parallel. A meshlet outside
+ * the frustum is not tested against its cone.
+ * @param meshlets The meshlets, in model space.
+ * @param model_view_projection The full transform of the mesh.
+ * @param camera The camera position in model space.
+ * @param frustum Whether to cull the meshlets outside the view frustum.
+ * @param backface Whether to cull the meshlets that only have backfacing
+ * triangles. Only correct for meshes whose back faces are hidden.
+ * @param visible Whether every meshlet is visible.
+ * @param stats The number of meshlets of every outcome.
+ */
+void CullMeshlets(const std::vector<Meshlet> &meshlets,
+                  const glm::mat4x4 &model_view_projection,
+                  const glm::vec3 &camera, bool frustum, bool backface,
+                  std::vector<char> *visible, MeshletCullStats *stats);
+
+}  // namespace data_representation
+
+#endif  // MESHLET_H_
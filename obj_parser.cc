@@ -0,0 +1,315 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <obj_parser.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "./parallel.h"
+#include "./text_parsing.h"
+
+namespace data_representation {
+
+namespace {
+
+const size_t kMinChunkSize = 1 << 20;
+
+/**
+ * @brief The RelativeIndex struct A corner attribute given with a negative
+ * index. It is stored relative to the start of its chunk until the chunk
+ * bases are known.
+ */
+struct RelativeIndex {
+  size_t corner;
+  int attribute;
+};
+
+struct ObjChunk {
+  ObjData data;
+  std::vector<RelativeIndex> relative;
+  size_t line;
+  bool valid;
+};
+
+inline int *AttributeIndex(ObjCorner *corner, int attribute) {
+  if (attribute == 0) return &corner->position;
+  return attribute == 1 ? &corner->texcoord : &corner->normal;
+}
+
+inline bool IsBlank(const char *p, const char *end) {
+  return p == end || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n';
+}
+
+bool ParseFloats(const char *p, const char *end, size_t count,
+                 std::vector<float> *values) {
+  for (size_t i = 0; i < count; ++i) {
+    p = SkipSpaces(p, end);
+    float value;
+    if (!ParseFloat(&p, end, &value)) return false;
+    values->push_back(value);
+  }
+  return true;
+}
+
+/**
+ * @brief ParseCorner Parses a v, v/vt, v//vn or v/vt/vn face corner.
+ * @param counts Number of positions, texcoords and normals parsed so far in
+ * the chunk.
+ * @param relative Bit i is set if attribute i was given relative to the end
+ * of the chunk.
+ */
+bool ParseCorner(const char **p, const char *end, const size_t counts[3],
+                 ObjCorner *corner, int *relative) {
+  *relative = 0;
+  corner->texcoord = -1;
+  corner->normal = -1;
+
+  for (int attribute = 0; attribute < 3; ++attribute) {
+    if (attribute > 0) {
+      if (*p == end || **p != '/') break;
+      ++*p;
+      if (attribute == 1 && *p < end && **p == '/') continue;
+    }
+
+    int64_t index;
+    if (!ParseInt(p, end, &index) || index == 0) return false;
+    if (index > 0) {
+      *AttributeIndex(corner, attribute) = static_cast<int>(index - 1);
+    } else {
+      *AttributeIndex(corner, attribute) =
+          static_cast<int>(counts[attribute] + index);
+      *relative |= 1 << attribute;
+    }
+  }
+  return IsBlank(*p, end);
+}
+
+bool ParseFace(const char *p, const char *end, ObjChunk *chunk) {
+  ObjData *data = &chunk->data;
+  const size_t kCounts[3] = {data->positions.size() / 3,
+                             data->texcoords.size() / 2,
+                             data->normals.size() / 3};
+
+  ObjCorner polygon[3];
+  int relative[3];
+  size_t corners = 0;
+  for (p = SkipSpaces(p, end); p < end && *p != '\n';
+       p = SkipSpaces(p, end)) {
+    const size_t kSlot = corners < 3 ? corners : 2;
+    if (!ParseCorner(&p, end, kCounts, &polygon[kSlot], &relative[kSlot]))
+      return false;
+
+    // Triangulate as a fan around the first corner.
+    if (++corners >= 3) {
+      for (size_t i = 0; i < 3; ++i) {
+        for (int attribute = 0; attribute < 3; ++attribute)
+          if (relative[i] & (1 << attribute))
+            chunk->relative.push_back({data->corners.size(), attribute});
+        data->corners.push_back(polygon[i]);
+      }
+      polygon[1] = polygon[2];
+      relative[1] = relative[2];
+    }
+  }
+  return corners >= 3;
+}
+
+void ParseMaterialLibraries(const char *p, const char *end, ObjChunk *chunk) {
+  while (true) {
+    p = SkipSpaces(p, end);
+    const char *kName = p;
+    while (!IsBlank(p, end)) ++p;
+    if (p == kName) return;
+    chunk->data.material_libraries.push_back(
+        std::string(kName, static_cast<size_t>(p - kName)));
+  }
+}
+
+void ParseMaterialUse(const char *p, const char *end, ObjChunk *chunk) {
+  p = SkipSpaces(p, end);
+  const char *kName = p;
+  while (p < end && *p != '\n') ++p;
+  while (p > kName && (p[-1] == ' ' || p[-1] == '\t' || p[-1] == '\r')) --p;
+  chunk->data.material_uses.push_back(
+      {chunk->data.corners.size(),
+       std::string(kName, static_cast<size_t>(p - kName))});
+}
+
+void ParseChunk(const char *begin, const char *end, ObjChunk *chunk) {
+  ObjData *data = &chunk->data;
+  chunk->line = 0;
+  chunk->valid = true;
+
+  for (const char *p = begin; p < end; p = SkipLine(p, end), ++chunk->line) {
+    p = SkipSpaces(p, end);
+    if (p == end) break;
+
+    bool res = true;
+    if (p[0] == 'v' && IsBlank(p + 1, end)) {
+      res = ParseFloats(p + 1, end, 3, &data->positions);
+    } else if (p[0] == 'v' && end - p > 1 && p[1] == 't' &&
+               IsBlank(p + 2, end)) {
+      res = ParseFloats(p + 2, end, 2, &data->texcoords);
+    } else if (p[0] == 'v' && end - p > 1 && p[1] == 'n' &&
+               IsBlank(p + 2, end)) {
+      res = ParseFloats(p + 2, end, 3, &data->normals);
+    } else if (p[0] == 'f' && IsBlank(p + 1, end)) {
+      res = ParseFace(p + 1, end, chunk);
+    } else if (end - p > 6 && strncmp(p, "mtllib", 6) == 0 &&
+               IsBlank(p + 6, end)) {
+      ParseMaterialLibraries(p + 6, end, chunk);
+    } else if (end - p > 6 && strncmp(p, "usemtl", 6) == 0 &&
+               IsBlank(p + 6, end)) {
+      ParseMaterialUse(p + 6, end, chunk);
+    }
+
+    if (!res) {
+      chunk->valid = false;
+      return;
+    }
+  }
+}
+
+inline uint32_t HashCorner(const ObjCorner &corner) {
+  uint32_t hash = static_cast<uint32_t>(corner.position) * 0x9E3779B1u;
+  hash ^= static_cast<uint32_t>(corner.texcoord) * 0x85EBCA77u;
+  hash ^= static_cast<uint32_t>(corner.normal) * 0xC2B2AE3Du;
+  return hash ^ (hash >> 15);
+}
+
+inline bool SameCorner(const ObjCorner &a, const ObjCorner &b) {
+  return a.position == b.position && a.texcoord == b.texcoord &&
+         a.normal == b.normal;
+}
+
+template <typename T>
+void CopyInto(const std::vector<T> &source, size_t offset,
+              std::vector<T> *destination) {
+  if (!source.empty())
+    memcpy(&(*destination)[offset], source.data(), sizeof(T) * source.size());
+}
+
+}  // namespace
+
+bool ParseObj(const char *data, size_t size, ObjData *obj) {
+  const char *kEnd = data + size;
+  const size_t kChunks = NumChunks(size, kMinChunkSize);
+
+  // Chunk boundaries are moved forward to the next line start.
+  std::vector<const char *> bounds(kChunks + 1, kEnd);
+  bounds[0] = data;
+  for (size_t c = 1; c < kChunks; ++c)
+    bounds[c] = std::max(bounds[c - 1],
+                         SkipLine(data + size * c / kChunks - 1, kEnd));
+
+  std::vector<ObjChunk> chunks(kChunks);
+  ParallelForChunks(kChunks, kChunks, [&](size_t c, size_t, size_t) {
+    ParseChunk(bounds[c], bounds[c + 1], &chunks[c]);
+  });
+
+  size_t line = 1;
+  for (const auto &chunk : chunks) {
+    if (!chunk.valid) {
+      std::cerr << "Invalid OBJ statement at line " << line + chunk.line
+                << std::endl;
+      return false;
+    }
+    line += chunk.line;
+  }
+
+  // Prefix sums give the base of every chunk in the merged arrays.
+  std::vector<size_t> bases(4 * (kChunks + 1), 0);
+  for (size_t c = 0; c < kChunks; ++c) {
+    const ObjData &chunk = chunks[c].data;
+    bases[4 * (c + 1)] = bases[4 * c] + chunk.positions.size();
+    bases[4 * (c + 1) + 1] = bases[4 * c + 1] + chunk.texcoords.size();
+    bases[4 * (c + 1) + 2] = bases[4 * c + 2] + chunk.normals.size();
+    bases[4 * (c + 1) + 3] = bases[4 * c + 3] + chunk.corners.size();
+  }
+  obj->positions.resize(bases[4 * kChunks]);
+  obj->texcoords.resize(bases[4 * kChunks + 1]);
+  obj->normals.resize(bases[4 * kChunks + 2]);
+  obj->corners.resize(bases[4 * kChunks + 3]);
+
+  const size_t kCounts[3] = {obj->positions.size() / 3,
+                             obj->texcoords.size() / 2,
+                             obj->normals.size() / 3};
+  std::atomic<bool> valid(true);
+  ParallelForChunks(kChunks, kChunks, [&](size_t c, size_t, size_t) {
+    const ObjChunk &chunk = chunks[c];
+    const size_t *kBase = &bases[4 * c];
+    CopyInto(chunk.data.positions, kBase[0], &obj->positions);
+    CopyInto(chunk.data.texcoords, kBase[1], &obj->texcoords);
+    CopyInto(chunk.data.normals, kBase[2], &obj->normals);
+    CopyInto(chunk.data.corners, kBase[3], &obj->corners);
+
+    ObjCorner *corners = obj->corners.data() + kBase[3];
+    const int kAttributeBase[3] = {static_cast<int>(kBase[0] / 3),
+                                   static_cast<int>(kBase[1] / 2),
+                                   static_cast<int>(kBase[2] / 3)};
+    for (const auto &relative : chunk.relative)
+      *AttributeIndex(&corners[relative.corner], relative.attribute) +=
+          kAttributeBase[relative.attribute];
+
+    for (size_t i = 0; i < chunk.data.corners.size(); ++i) {
+      for (int attribute = 0; attribute < 3; ++attribute) {
+        const int kIndex = *AttributeIndex(&corners[i], attribute);
+        if (attribute > 0 && kIndex == -1) continue;
+        if (kIndex < 0 || static_cast<size_t>(kIndex) >= kCounts[attribute])
+          valid = false;
+      }
+    }
+  });
+
+  if (!valid) {
+    std::cerr << "OBJ face index out of range." << std::endl;
+    return false;
+  }
+
+  for (size_t c = 0; c < kChunks; ++c) {
+    const ObjData &chunk = chunks[c].data;
+    obj->material_libraries.insert(obj->material_libraries.end(),
+                                   chunk.material_libraries.begin(),
+                                   chunk.material_libraries.end());
+    for (const auto &use : chunk.material_uses)
+      obj->material_uses.push_back(
+          {bases[4 * c + 3] + use.first_corner, use.name});
+  }
+  return true;
+}
+
+void IndexObjCorners(const std::vector<ObjCorner> &corners,
+                     std::vector<int> *faces,
+                     std::vector<ObjCorner> *vertices) {
+  // Power of two capacity with a load factor of at most one half.
+  size_t capacity = 16;
+  while (capacity < corners.size() * 2) capacity *= 2;
+  const uint32_t kMask = static_cast<uint32_t>(capacity - 1);
+
+  // Slots hold vertex index + 1, so that 0 marks an empty slot.
+  std::vector<uint32_t> slots(capacity, 0);
+  faces->resize(corners.size());
+  vertices->clear();
+  vertices->reserve(corners.size() / 2);
+
+  for (size_t i = 0; i < corners.size(); ++i) {
+    const ObjCorner &corner = corners[i];
+    uint32_t slot = HashCorner(corner) & kMask;
+    while (slots[slot] != 0 &&
+           !SameCorner((*vertices)[slots[slot] - 1], corner))
+      slot = (slot + 1) & kMask;
+
+    if (slots[slot] == 0) {
+      vertices->push_back(corner);
+      slots[slot] = static_cast<uint32_t>(vertices->size());
+    }
+    (*faces)[i] = static_cast<int>(slots[slot] - 1);
+  }
+}
+
+}  // namespace data_representation
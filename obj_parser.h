@@ -0,0 +1,83 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef OBJ_PARSER_H_
+#define OBJ_PARSER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief The ObjCorner struct Zero-based attribute indices of a triangle
+ * corner. Missing texture coordinates or normals are -1.
+ */
+struct ObjCorner {
+  int position;
+  int texcoord;
+  int normal;
+};
+
+/**
+ * @brief The ObjMaterialUse struct A usemtl statement: the faces from
+ * first_corner onwards use the material called name.
+ */
+struct ObjMaterialUse {
+  size_t first_corner;
+  std::string name;
+};
+
+/**
+ * @brief The ObjData struct Raw contents of an OBJ file, with the attribute
+ * arrays exactly as they appear in the file and polygons triangulated as
+ * fans.
+ */
+struct ObjData {
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<float> texcoords;
+
+  /**
+   * @brief corners Three consecutive corners per triangle.
+   */
+  std::vector<ObjCorner> corners;
+
+  /**
+   * @brief material_libraries The files referenced by mtllib statements.
+   */
+  std::vector<std::string> material_libraries;
+
+  /**
+   * @brief material_uses The usemtl statements in file order.
+   */
+  std::vector<ObjMaterialUse> material_uses;
+};
+
+/**
+ * @brief ParseObj Parses the v, vt, vn, f, mtllib and usemtl statements of an OBJ
+ * file. The buffer is split on line boundaries into one chunk per thread; the
+ * chunks are parsed independently and merged afterwards, rebasing relative
+ * (negative) indices.
+ * @param data The file contents.
+ * @param size The file size.
+ * @param obj The parsed contents.
+ * @return Whether the file was valid.
+ */
+bool ParseObj(const char *data, size_t size, ObjData *obj);
+
+/**
+ * @brief IndexObjCorners Builds an indexed mesh out of the triangle corners by
+ * merging corners that reference the same position, texcoord and normal. An
+ * open-addressing hash table keyed by the index triplet is used, and vertices
+ * keep the order of their first use.
+ * @param corners Three consecutive corners per triangle.
+ * @param faces Resulting index of the vertex used by every corner.
+ * @param vertices Resulting unique corners.
+ */
+void IndexObjCorners(const std::vector<ObjCorner> &corners,
+                     std::vector<int> *faces, std::vector<ObjCorner> *vertices);
+
+}  // namespace data_representation
+
+#endif  // OBJ_PARSER_H_
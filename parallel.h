@@ -0,0 +1,109 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief ThreadBudget Maximum number of threads the parallel loops started
+ * from the calling thread may use, 0 meaning no limit.
+ */
+inline size_t &ThreadBudget() {
+  static thread_local size_t budget = 0;
+  return budget;
+}
+
+/**
+ * @brief The ScopedThreadBudget class Limits the threads used by the parallel
+ * loops of the calling thread while it is alive.
+ */
+class ScopedThreadBudget {
+ public:
+  explicit ScopedThreadBudget(size_t budget) : previous_(ThreadBudget()) {
+    ThreadBudget() = budget;
+  }
+  ~ScopedThreadBudget() { ThreadBudget() = previous_; }
+
+  ScopedThreadBudget(const ScopedThreadBudget &) = delete;
+  ScopedThreadBudget &operator=(const ScopedThreadBudget &) = delete;
+
+ private:
+  size_t previous_;
+};
+
+/**
+ * @brief NumThreads Number of worker threads used by the parallel loops.
+ * @return The thread budget of the calling thread if it has one, otherwise
+ * the hardware concurrency, or 1 if it cannot be determined.
+ */
+inline size_t NumThreads() {
+  if (ThreadBudget() > 0) return ThreadBudget();
+  const unsigned int kThreads = std::thread::hardware_concurrency();
+  return kThreads > 0 ? kThreads : 1;
+}
+
+/**
+ * @brief NumChunks Number of chunks a range of n items is split into so that
+ * each chunk holds at least min_grain items.
+ * @param n The number of items.
+ * @param min_grain The minimum number of items per chunk.
+ * @return A value in [1, NumThreads()].
+ */
+inline size_t NumChunks(size_t n, size_t min_grain) {
+  const size_t kGrain = std::max<size_t>(min_grain, 1);
+  return std::max<size_t>(1, std::min(NumThreads(), n / kGrain));
+}
+
+/**
+ * @brief ParallelForChunks Splits [0, n) into chunks contiguous ranges and
+ * calls f(chunk, begin, end) for each of them on its own thread. The calling
+ * thread processes the last chunk. Parallel loops nested inside f run
+ * serially.
+ * @param n The number of items.
+ * @param chunks The number of chunks, as returned by NumChunks.
+ * @param f The function to execute for each chunk.
+ */
+template <typename F>
+void ParallelForChunks(size_t n, size_t chunks, const F &f) {
+  if (chunks <= 1 || n == 0) {
+    f(size_t(0), size_t(0), n);
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  workers.reserve(chunks - 1);
+  for (size_t c = 0; c + 1 < chunks; ++c)
+    workers.emplace_back([&f, c, n, chunks]() {
+      ScopedThreadBudget serial(1);
+      f(c, n * c / chunks, n * (c + 1) / chunks);
+    });
+  {
+    ScopedThreadBudget serial(1);
+    f(chunks - 1, n * (chunks - 1) / chunks, n);
+  }
+
+  for (auto &worker : workers) worker.join();
+}
+
+/**
+ * @brief ParallelFor Calls f(begin, end) over contiguous subranges of [0, n)
+ * using all available threads.
+ * @param n The number of items.
+ * @param min_grain The minimum number of items processed by a thread.
+ * @param f The function to execute for each subrange.
+ */
+template <typename F>
+void ParallelFor(size_t n, size_t min_grain, const F &f) {
+  ParallelForChunks(n, NumChunks(n, min_grain),
+                    [&f](size_t, size_t begin, size_t end) { f(begin, end); });
+}
+
+}  // namespace data_representation
+
+#endif  // PARALLEL_H_
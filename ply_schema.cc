@@ -0,0 +1,689 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <ply_schema.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "./parallel.h"
+#include "./text_parsing.h"
+
+namespace data_representation {
+
+namespace {
+
+const size_t kMinGrain = 1 << 15;
+
+bool ParsePlyType(const std::string &name, PlyType *type) {
+  if (name == "char" || name == "int8") {
+    *type = PlyType::kInt8;
+  } else if (name == "uchar" || name == "uint8") {
+    *type = PlyType::kUInt8;
+  } else if (name == "short" || name == "int16") {
+    *type = PlyType::kInt16;
+  } else if (name == "ushort" || name == "uint16") {
+    *type = PlyType::kUInt16;
+  } else if (name == "int" || name == "int32") {
+    *type = PlyType::kInt32;
+  } else if (name == "uint" || name == "uint32") {
+    *type = PlyType::kUInt32;
+  } else if (name == "float" || name == "float32") {
+    *type = PlyType::kFloat32;
+  } else if (name == "double" || name == "float64") {
+    *type = PlyType::kFloat64;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template <typename T>
+T LoadValue(const char *p, bool swap) {
+  T value;
+  if (!swap) {
+    memcpy(&value, p, sizeof(T));
+    return value;
+  }
+
+  char bytes[sizeof(T)];
+  for (size_t i = 0; i < sizeof(T); ++i) bytes[i] = p[sizeof(T) - 1 - i];
+  memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+double LoadPlyValue(const char *p, PlyType type, bool swap) {
+  switch (type) {
+    case PlyType::kInt8:
+      return LoadValue<int8_t>(p, swap);
+    case PlyType::kUInt8:
+      return LoadValue<uint8_t>(p, swap);
+    case PlyType::kInt16:
+      return LoadValue<int16_t>(p, swap);
+    case PlyType::kUInt16:
+      return LoadValue<uint16_t>(p, swap);
+    case PlyType::kInt32:
+      return LoadValue<int32_t>(p, swap);
+    case PlyType::kUInt32:
+      return LoadValue<uint32_t>(p, swap);
+    case PlyType::kFloat32:
+      return LoadValue<float>(p, swap);
+    case PlyType::kFloat64:
+      return LoadValue<double>(p, swap);
+  }
+  return 0.0;
+}
+
+/**
+ * @brief The PlyColumn struct Location of a scalar property inside a binary
+ * record.
+ */
+struct PlyColumn {
+  size_t offset;
+  PlyType type;
+};
+
+/**
+ * @brief kFirstStreamSlot Slot of the first vertex property stored in a
+ * stream, see VertexSlots.
+ */
+const int kFirstStreamSlot = 8;
+
+/**
+ * @brief kColorChannels Vertex properties stored, as unsigned normalized
+ * bytes, in the components of the "color" stream.
+ */
+const char *const kColorChannels[] = {"red", "green", "blue", "alpha"};
+
+/**
+ * @brief The StreamColumn struct A vertex property stored in a component of a
+ * stream of the mesh.
+ */
+struct StreamColumn {
+  size_t stream;
+  size_t component;
+  PlyColumn column;
+};
+
+/**
+ * @brief The VertexPlan struct Decode plan of a fixed-stride vertex element.
+ * Columns 0-2 hold the position, 3-5 the optional normal and 6-7 the
+ * optional texture coordinates.
+ */
+struct VertexPlan {
+  size_t stride;
+  PlyColumn columns[kFirstStreamSlot];
+  bool has_normals;
+  bool has_tex_coords;
+  bool packed_positions;
+  std::vector<StreamColumn> streams;
+};
+
+/**
+ * @brief The TrianglePlan struct Decode plan of a face element whose records
+ * are assumed to be triangles: fixed properties, the index list, and more
+ * fixed properties.
+ */
+struct TrianglePlan {
+  size_t count_offset;
+  size_t stride;
+  PlyType count_type;
+  PlyType index_type;
+};
+
+/**
+ * @brief kTexCoordNames Pairs of vertex property names holding texture
+ * coordinates, in order of preference.
+ */
+const char *const kTexCoordNames[][2] = {
+    {"s", "t"}, {"u", "v"}, {"texture_u", "texture_v"}};
+
+/**
+ * @brief VertexSlots Maps every vertex property to the mesh attribute it is
+ * stored in: 0-2 for the position, 3-5 for the normal, 6-7 for the texture
+ * coordinates, -1 if skipped. Texture coordinates are only taken from a
+ * complete pair of kTexCoordNames.
+ */
+std::vector<int> VertexSlots(const PlyElement &element) {
+  const char *kNames[] = {"x", "y", "z", "nx", "ny", "nz"};
+  std::vector<int> slots(element.properties.size(), -1);
+  auto scalar = [&](const char *name) {
+    const int kProperty = element.FindProperty(name);
+    return kProperty >= 0 && !element.properties[kProperty].is_list
+               ? kProperty
+               : -1;
+  };
+  for (int slot = 0; slot < 6; ++slot) {
+    const int kProperty = scalar(kNames[slot]);
+    if (kProperty >= 0) slots[kProperty] = slot;
+  }
+  for (const auto &kPair : kTexCoordNames) {
+    const int kU = scalar(kPair[0]), kV = scalar(kPair[1]);
+    if (kU < 0 || kV < 0) continue;
+    slots[kU] = 6;
+    slots[kV] = 7;
+    break;
+  }
+  return slots;
+}
+
+/**
+ * @brief VertexStreams Adds a stream to the mesh for the other scalar vertex
+ * properties, and their slots from kFirstStreamSlot. Byte color channels are
+ * gathered in the "color" stream. Any other property gets a stream of its
+ * own, named after it: bytes and 16-bit unsigned integers are kept as they
+ * are, with a scale that restores their values, and the other types become
+ * floats.
+ * @param element The vertex element.
+ * @param slots The slots of VertexSlots, extended with those of the streams.
+ * @param streams The streams of the mesh, with a zeroed record per vertex.
+ * @return The destination of every slot from kFirstStreamSlot.
+ */
+std::vector<StreamColumn> VertexStreams(const PlyElement &element,
+                                        std::vector<int> *slots,
+                                        std::vector<VertexStream> *streams) {
+  std::vector<StreamColumn> columns;
+  auto add = [&](size_t property, size_t stream, size_t component) {
+    (*slots)[property] = kFirstStreamSlot + static_cast<int>(columns.size());
+    columns.push_back({stream, component,
+                       {0, element.properties[property].type}});
+  };
+
+  for (const char *kChannel : kColorChannels) {
+    const int kProperty = element.FindProperty(kChannel);
+    if (kProperty < 0 || (*slots)[kProperty] >= 0 ||
+        element.properties[kProperty].is_list ||
+        element.properties[kProperty].type != PlyType::kUInt8)
+      continue;
+    if (streams->empty() || streams->back().name != "color")
+      streams->push_back(
+          MakeVertexStream("color", ComponentType::kUnorm8, 0, 0));
+    add(kProperty, streams->size() - 1, streams->back().components++);
+  }
+
+  for (size_t p = 0; p < element.properties.size(); ++p) {
+    const PlyProperty &property = element.properties[p];
+    if ((*slots)[p] >= 0 || property.is_list) continue;
+    ComponentType type = ComponentType::kFloat32;
+    float scale = 1.0f;
+    if (property.type == PlyType::kUInt8) {
+      type = ComponentType::kUnorm8;
+      scale = 255.0f;
+    } else if (property.type == PlyType::kUInt16) {
+      type = ComponentType::kUnorm16;
+      scale = 65535.0f;
+    }
+    streams->push_back(MakeVertexStream(property.name, type, 1, 0));
+    streams->back().scale = scale;
+    add(p, streams->size() - 1, 0);
+  }
+
+  for (auto &stream : *streams) {
+    stream.stride =
+        static_cast<uint32_t>(ComponentBytes(stream.type, stream.components));
+    stream.data.assign(element.count * stream.stride, 0);
+  }
+  return columns;
+}
+
+/**
+ * @brief StoreComponent Stores a property value in a component of the record
+ * of a vertex, as it is for normalized integers.
+ */
+inline void StoreComponent(double value, size_t vertex, size_t component,
+                           VertexStream *stream) {
+  uint8_t *record = &stream->data[vertex * stream->stride];
+  if (stream->type == ComponentType::kUnorm8) {
+    record[component] = static_cast<uint8_t>(value);
+  } else if (stream->type == ComponentType::kUnorm16) {
+    const uint16_t kValue = static_cast<uint16_t>(value);
+    memcpy(record + component * sizeof(kValue), &kValue, sizeof(kValue));
+  } else {
+    const float kValue = static_cast<float>(value);
+    memcpy(record + component * sizeof(kValue), &kValue, sizeof(kValue));
+  }
+}
+
+int IndexListProperty(const PlyElement &element) {
+  int property = element.FindProperty("vertex_indices");
+  if (property < 0) property = element.FindProperty("vertex_index");
+  if (property >= 0 && !element.properties[property].is_list) property = -1;
+  return property;
+}
+
+VertexPlan CompileVertexPlan(const PlyElement &element,
+                             const std::vector<int> &slots,
+                             const std::vector<StreamColumn> &streams,
+                             bool swap) {
+  VertexPlan plan;
+  plan.stride = element.Stride();
+  plan.has_normals = false;
+  plan.has_tex_coords = false;
+
+  size_t offset = 0;
+  int found = 0;
+  for (size_t i = 0; i < element.properties.size(); ++i) {
+    if (slots[i] >= kFirstStreamSlot) {
+      plan.streams.push_back(streams[slots[i] - kFirstStreamSlot]);
+      plan.streams.back().column.offset = offset;
+    } else if (slots[i] >= 0) {
+      plan.columns[slots[i]].offset = offset;
+      plan.columns[slots[i]].type = element.properties[i].type;
+      found |= 1 << slots[i];
+    }
+    offset += PlyTypeSize(element.properties[i].type);
+  }
+  plan.has_normals = (found & 0x38) == 0x38;
+  plan.has_tex_coords = (found & 0xC0) == 0xC0;
+
+  plan.packed_positions = !swap && plan.stride == 3 * sizeof(float);
+  for (size_t i = 0; i < 3; ++i)
+    plan.packed_positions = plan.packed_positions &&
+                            plan.columns[i].type == PlyType::kFloat32 &&
+                            plan.columns[i].offset == i * sizeof(float);
+  return plan;
+}
+
+bool CompileTrianglePlan(const PlyElement &element, int index_list,
+                         TrianglePlan *plan) {
+  size_t offset = 0;
+  for (size_t i = 0; i < element.properties.size(); ++i) {
+    const PlyProperty &property = element.properties[i];
+    if (static_cast<int>(i) == index_list) {
+      plan->count_offset = offset;
+      plan->count_type = property.count_type;
+      plan->index_type = property.type;
+      offset += PlyTypeSize(property.count_type) + 3 * PlyTypeSize(property.type);
+    } else if (property.is_list) {
+      return false;
+    } else {
+      offset += PlyTypeSize(property.type);
+    }
+  }
+  plan->stride = offset;
+  return true;
+}
+
+inline float LoadColumn(const char *record, const PlyColumn &column,
+                        bool swap) {
+  if (column.type == PlyType::kFloat32 && !swap) {
+    float value;
+    memcpy(&value, record + column.offset, sizeof(float));
+    return value;
+  }
+  return static_cast<float>(
+      LoadPlyValue(record + column.offset, column.type, swap));
+}
+
+void DecodeVertexBlock(const char *block, size_t count, const VertexPlan &plan,
+                       bool swap, TriangleMesh *mesh) {
+  ParallelFor(count, kMinGrain, [&](size_t begin, size_t end) {
+    if (plan.packed_positions) {
+      memcpy(&mesh->vertices_[begin * 3], block + begin * plan.stride,
+             (end - begin) * plan.stride);
+      return;
+    }
+
+    for (size_t i = begin; i < end; ++i) {
+      const char *record = block + i * plan.stride;
+      for (size_t j = 0; j < 3; ++j)
+        mesh->vertices_[i * 3 + j] = LoadColumn(record, plan.columns[j], swap);
+      if (plan.has_normals) {
+        for (size_t j = 0; j < 3; ++j)
+          mesh->normals_[i * 3 + j] =
+              LoadColumn(record, plan.columns[j + 3], swap);
+      }
+      if (plan.has_tex_coords) {
+        for (size_t j = 0; j < 2; ++j)
+          mesh->texCoords_[i * 2 + j] =
+              LoadColumn(record, plan.columns[j + 6], swap);
+      }
+      for (const StreamColumn &stream : plan.streams)
+        StoreComponent(
+            LoadPlyValue(record + stream.column.offset, stream.column.type,
+                         swap),
+            i, stream.component, &mesh->streams_[stream.stream]);
+    }
+  });
+}
+
+/**
+ * @brief DecodeTriangleBlock Decodes a face block under the assumption that
+ * every face is a triangle.
+ * @return False if the block does not fit or some face is not a triangle, in
+ * which case the sequential decoder has to be used.
+ */
+bool DecodeTriangleBlock(const char *block, size_t available, size_t count,
+                         const TrianglePlan &plan, bool swap,
+                         TriangleMesh *mesh) {
+  if (plan.stride == 0 || available / plan.stride < count) return false;
+
+  const size_t kCountSize = PlyTypeSize(plan.count_type);
+  const bool kCopyIndices =
+      !swap && (plan.index_type == PlyType::kInt32 ||
+                plan.index_type == PlyType::kUInt32);
+  const size_t kIndexSize = PlyTypeSize(plan.index_type);
+
+  mesh->faces_.resize(count * 3);
+  std::atomic<bool> triangles(true);
+  ParallelFor(count, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end && triangles; ++i) {
+      const char *record = block + i * plan.stride + plan.count_offset;
+      if (LoadPlyValue(record, plan.count_type, swap) != 3.0) {
+        triangles = false;
+        return;
+      }
+
+      const char *indices = record + kCountSize;
+      if (kCopyIndices) {
+        memcpy(&mesh->faces_[i * 3], indices, 3 * sizeof(int));
+      } else {
+        for (size_t j = 0; j < 3; ++j)
+          mesh->faces_[i * 3 + j] = static_cast<int>(
+              LoadPlyValue(indices + j * kIndexSize, plan.index_type, swap));
+      }
+    }
+  });
+
+  if (!triangles) mesh->faces_.clear();
+  return triangles;
+}
+
+/**
+ * @brief The PlyRecordReader class Sequential reader of ASCII or binary
+ * values, used by the fallback decoder.
+ */
+class PlyRecordReader {
+ public:
+  PlyRecordReader(const char *begin, const char *end, PlyFormat format,
+                  bool swap)
+      : p_(begin), end_(end), ascii_(format == PlyFormat::kAscii), swap_(swap) {}
+
+  bool Read(PlyType type, double *value) {
+    if (ascii_) {
+      p_ = SkipWhitespace(p_, end_);
+      return ParseDouble(&p_, end_, value);
+    }
+
+    const size_t kSize = PlyTypeSize(type);
+    if (static_cast<size_t>(end_ - p_) < kSize) return false;
+    *value = LoadPlyValue(p_, type, swap_);
+    p_ += kSize;
+    return true;
+  }
+
+  const char *position() const { return p_; }
+
+ private:
+  const char *p_;
+  const char *end_;
+  bool ascii_;
+  bool swap_;
+};
+
+bool DecodeRecords(const PlyElement &element, const std::vector<int> &slots,
+                   const std::vector<StreamColumn> &streams, int index_list,
+                   PlyRecordReader *reader, TriangleMesh *mesh) {
+  std::vector<int> polygon;
+  for (size_t i = 0; i < element.count; ++i) {
+    for (size_t p = 0; p < element.properties.size(); ++p) {
+      const PlyProperty &property = element.properties[p];
+      double value;
+      if (!property.is_list) {
+        if (!reader->Read(property.type, &value)) return false;
+        if (!slots.empty() && slots[p] >= kFirstStreamSlot) {
+          const StreamColumn &kStream = streams[slots[p] - kFirstStreamSlot];
+          StoreComponent(value, i, kStream.component,
+                         &mesh->streams_[kStream.stream]);
+        } else if (!slots.empty() && slots[p] >= 6) {
+          if (!mesh->texCoords_.empty())
+            mesh->texCoords_[i * 2 + slots[p] - 6] = value;
+        } else if (!slots.empty() && slots[p] >= 0) {
+          std::vector<float> &target =
+              slots[p] < 3 ? mesh->vertices_ : mesh->normals_;
+          if (!target.empty()) target[i * 3 + slots[p] % 3] = value;
+        }
+        continue;
+      }
+
+      double count;
+      if (!reader->Read(property.count_type, &count) || count < 0)
+        return false;
+      polygon.clear();
+      for (size_t k = 0; k < static_cast<size_t>(count); ++k) {
+        if (!reader->Read(property.type, &value)) return false;
+        polygon.push_back(static_cast<int>(value));
+      }
+
+      if (static_cast<int>(p) != index_list) continue;
+      for (size_t k = 2; k < polygon.size(); ++k) {
+        mesh->faces_.push_back(polygon[0]);
+        mesh->faces_.push_back(polygon[k - 1]);
+        mesh->faces_.push_back(polygon[k]);
+      }
+    }
+  }
+  return true;
+}
+
+bool ValidateFaces(size_t vertices, const std::vector<int> &faces) {
+  const int kVertices = static_cast<int>(vertices);
+  std::atomic<bool> valid(true);
+  ParallelFor(faces.size(), kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (faces[i] < 0 || faces[i] >= kVertices) {
+        valid = false;
+        return;
+      }
+    }
+  });
+  return valid;
+}
+
+}  // namespace
+
+bool IsHostLittleEndian() {
+  const uint16_t kOne = 1;
+  unsigned char first;
+  memcpy(&first, &kOne, 1);
+  return first == 1;
+}
+
+size_t PlyTypeSize(PlyType type) {
+  switch (type) {
+    case PlyType::kInt8:
+    case PlyType::kUInt8:
+      return 1;
+    case PlyType::kInt16:
+    case PlyType::kUInt16:
+      return 2;
+    case PlyType::kInt32:
+    case PlyType::kUInt32:
+    case PlyType::kFloat32:
+      return 4;
+    case PlyType::kFloat64:
+      return 8;
+  }
+  return 0;
+}
+
+int PlyElement::FindProperty(const std::string &property) const {
+  for (size_t i = 0; i < properties.size(); ++i)
+    if (properties[i].name == property) return static_cast<int>(i);
+  return -1;
+}
+
+size_t PlyElement::Stride() const {
+  size_t stride = 0;
+  for (const auto &property : properties) {
+    if (property.is_list) return 0;
+    stride += PlyTypeSize(property.type);
+  }
+  return stride;
+}
+
+const PlyElement *PlySchema::FindElement(const std::string &element) const {
+  for (const auto &e : elements)
+    if (e.name == element) return &e;
+  return nullptr;
+}
+
+bool ParsePlyHeader(const char *data, size_t size, PlySchema *schema) {
+  if (size < 3 || strncmp(data, "ply", 3) != 0) return false;
+
+  const char kEndHeader[] = "end_header";
+  const char *end = nullptr;
+  for (const char *c = data; c + sizeof(kEndHeader) - 1 <= data + size; ++c) {
+    if (strncmp(c, kEndHeader, sizeof(kEndHeader) - 1) == 0) {
+      end = c + sizeof(kEndHeader) - 1;
+      break;
+    }
+  }
+  if (end == nullptr) return false;
+  end = SkipLine(end, data + size);
+  schema->header_size = static_cast<size_t>(end - data);
+
+  bool has_format = false;
+  std::istringstream header(std::string(data, schema->header_size));
+  std::string line;
+  std::getline(header, line);
+  while (std::getline(header, line)) {
+    std::istringstream tokens(line);
+    std::string keyword;
+    tokens >> keyword;
+
+    if (keyword == "format") {
+      std::string format;
+      tokens >> format;
+      if (format == "ascii") {
+        schema->format = PlyFormat::kAscii;
+      } else if (format == "binary_little_endian") {
+        schema->format = PlyFormat::kBinaryLittleEndian;
+      } else if (format == "binary_big_endian") {
+        schema->format = PlyFormat::kBinaryBigEndian;
+      } else {
+        std::cerr << "Unknown PLY format " << format << std::endl;
+        return false;
+      }
+      has_format = true;
+    } else if (keyword == "element") {
+      PlyElement element;
+      element.count = 0;
+      tokens >> element.name >> element.count;
+      if (tokens.fail()) return false;
+      schema->elements.push_back(element);
+    } else if (keyword == "property") {
+      if (schema->elements.empty()) return false;
+
+      PlyProperty property;
+      std::string type;
+      tokens >> type;
+      property.is_list = type == "list";
+      property.count_type = PlyType::kUInt8;
+      if (property.is_list) {
+        std::string count_type;
+        tokens >> count_type >> type;
+        if (!ParsePlyType(count_type, &property.count_type)) {
+          std::cerr << "Unknown PLY type " << count_type << std::endl;
+          return false;
+        }
+      }
+      if (!ParsePlyType(type, &property.type)) {
+        std::cerr << "Unknown PLY type " << type << std::endl;
+        return false;
+      }
+      tokens >> property.name;
+      schema->elements.back().properties.push_back(property);
+    }
+  }
+
+  return has_format;
+}
+
+bool DecodePly(const char *data, size_t size, const PlySchema &schema,
+               TriangleMesh *mesh, LoadProfile *profile) {
+  const PlyElement *vertices = schema.FindElement("vertex");
+  if (vertices == nullptr || vertices->count == 0) return false;
+
+  std::vector<int> slots = VertexSlots(*vertices);
+  int found = 0;
+  for (int slot : slots)
+    if (slot >= 0) found |= 1 << slot;
+  if ((found & 0x7) != 0x7) {
+    std::cerr << "PLY vertices have no x, y, z properties." << std::endl;
+    return false;
+  }
+
+  mesh->vertices_.resize(vertices->count * 3);
+  if ((found & 0x38) == 0x38) mesh->normals_.resize(vertices->count * 3);
+  if ((found & 0xC0) == 0xC0) mesh->texCoords_.resize(vertices->count * 2);
+  mesh->faces_.clear();
+  mesh->streams_.clear();
+  const std::vector<StreamColumn> kStreams =
+      VertexStreams(*vertices, &slots, &mesh->streams_);
+
+  const bool kSwap =
+      (schema.format == PlyFormat::kBinaryBigEndian && IsHostLittleEndian()) ||
+      (schema.format == PlyFormat::kBinaryLittleEndian && !IsHostLittleEndian());
+  const bool kBinary = schema.format != PlyFormat::kAscii;
+  const char *kEnd = data + size;
+  const char *cursor = data + schema.header_size;
+
+  auto decode_element = [&](const PlyElement &element) {
+    const bool kIsVertex = &element == vertices;
+    const bool kIsFace = element.name == "face";
+    const int kIndexList = kIsFace ? IndexListProperty(element) : -1;
+    const size_t kAvailable = static_cast<size_t>(kEnd - cursor);
+    const size_t kStride = element.Stride();
+
+    if (kBinary && kStride > 0) {
+      if (kAvailable / kStride < element.count) return false;
+      if (kIsVertex)
+        DecodeVertexBlock(cursor, element.count,
+                          CompileVertexPlan(element, slots, kStreams, kSwap),
+                          kSwap, mesh);
+      cursor += element.count * kStride;
+      return true;
+    }
+
+    TrianglePlan plan;
+    if (kBinary && kIndexList >= 0 &&
+        CompileTrianglePlan(element, kIndexList, &plan) &&
+        DecodeTriangleBlock(cursor, kAvailable, element.count, plan, kSwap,
+                            mesh)) {
+      cursor += element.count * plan.stride;
+      return true;
+    }
+
+    PlyRecordReader reader(cursor, kEnd, schema.format, kSwap);
+    if (!DecodeRecords(element, kIsVertex ? slots : std::vector<int>(),
+                       kStreams, kIndexList, &reader, mesh))
+      return false;
+    cursor = reader.position();
+    return true;
+  };
+
+  for (const auto &element : schema.elements) {
+    const char *kStart = cursor;
+    const bool kDecoded = &element == vertices || element.name == "face";
+    ScopedStage stage(profile,
+                      element.name + (kDecoded ? " decode" : " skip"));
+    if (!decode_element(element)) return false;
+    stage.set_bytes(static_cast<uint64_t>(cursor - kStart));
+  }
+
+  ScopedStage stage(profile, "validate faces",
+                    sizeof(int) * mesh->faces_.size());
+  if (!ValidateFaces(vertices->count, mesh->faces_)) {
+    std::cerr << "PLY face index out of range." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace data_representation
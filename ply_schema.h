@@ -0,0 +1,124 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef PLY_SCHEMA_H_
+#define PLY_SCHEMA_H_
+
+#include <load_profile.h>
+#include <triangle_mesh.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+enum class PlyFormat { kAscii, kBinaryLittleEndian, kBinaryBigEndian };
+
+enum class PlyType {
+  kInt8,
+  kUInt8,
+  kInt16,
+  kUInt16,
+  kInt32,
+  kUInt32,
+  kFloat32,
+  kFloat64
+};
+
+/**
+ * @brief IsHostLittleEndian Whether binary PLY data written by this machine is
+ * little endian.
+ */
+bool IsHostLittleEndian();
+
+/**
+ * @brief PlyTypeSize Size in bytes of a value of the given type in a binary
+ * PLY file.
+ */
+size_t PlyTypeSize(PlyType type);
+
+/**
+ * @brief The PlyProperty struct A scalar or list property of an element.
+ */
+struct PlyProperty {
+  std::string name;
+  PlyType type;
+  bool is_list;
+  /**
+   * @brief count_type Type of the list length. Only used by list properties.
+   */
+  PlyType count_type;
+};
+
+/**
+ * @brief The PlyElement struct An element declared in the header, e.g. the
+ * vertices or the faces.
+ */
+struct PlyElement {
+  std::string name;
+  size_t count;
+  std::vector<PlyProperty> properties;
+
+  /**
+   * @brief FindProperty Index of the property with the given name.
+   * @return The property index or -1 if it does not exist.
+   */
+  int FindProperty(const std::string &property) const;
+
+  /**
+   * @brief Stride Size in bytes of a binary record of this element.
+   * @return The record size or 0 if the element has list properties.
+   */
+  size_t Stride() const;
+};
+
+/**
+ * @brief The PlySchema struct Layout of a PLY file as declared by its header.
+ */
+struct PlySchema {
+  PlyFormat format;
+  std::vector<PlyElement> elements;
+
+  /**
+   * @brief header_size Offset of the first byte after end_header.
+   */
+  size_t header_size;
+
+  /**
+   * @brief FindElement Returns the element with the given name or nullptr.
+   */
+  const PlyElement *FindElement(const std::string &element) const;
+};
+
+/**
+ * @brief ParsePlyHeader Builds the schema of the PLY file stored in data.
+ * @param data The file contents.
+ * @param size The file size.
+ * @param schema The resulting schema.
+ * @return Whether the header was valid.
+ */
+bool ParsePlyHeader(const char *data, size_t size, PlySchema *schema);
+
+/**
+ * @brief DecodePly Decodes the vertex positions, the optional per-vertex
+ * normals and texture coordinates (s/t, u/v or texture_u/texture_v) and the
+ * faces of a PLY file into the mesh, and the other scalar vertex properties
+ * into its streams, see VertexStream. A decode plan is
+ * compiled from the schema: fixed-stride binary blocks are copied column by
+ * column in parallel, while ASCII files, list-typed vertices and
+ * non-triangular faces go through a sequential fallback. Polygons are
+ * triangulated as fans and unknown elements are skipped.
+ * @param data The file contents.
+ * @param size The file size.
+ * @param schema The schema returned by ParsePlyHeader.
+ * @param mesh The resulting representation. normals_ and texCoords_ are left
+ * empty if the file does not have them.
+ * @param profile If not null, receives the decode time of every element.
+ * @return Whether the file could be decoded.
+ */
+bool DecodePly(const char *data, size_t size, const PlySchema &schema,
+               TriangleMesh *mesh, LoadProfile *profile = nullptr);
+
+}  // namespace data_representation
+
+#endif  // PLY_SCHEMA_H_
@@ -0,0 +1,122 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef RADIX_SORT_H_
+#define RADIX_SORT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+/**
+ * @brief kRadixSortGrain Minimum number of entries sorted by a thread.
+ */
+const size_t kRadixSortGrain = 1 << 14;
+
+/**
+ * @brief RadixSortBits Bits to sort keys up to max_key by, a multiple of 8.
+ */
+inline int RadixSortBits(uint32_t max_key) {
+  int bits = 8;
+  while (bits < 32 && (max_key >> bits) != 0) bits += 8;
+  return bits;
+}
+
+/**
+ * @brief RadixSortRange Stable least significant digit radix sort of [first,
+ * last) by the lowest bits of the uint32_t member key of T, one byte per pass.
+ * Meant for ranges that fit in cache.
+ * @param first The first entry.
+ * @param last One past the last entry.
+ * @param bits The bits of the key to sort by.
+ * @param scratch Buffer for the passes, grown as needed.
+ */
+template <typename T>
+void RadixSortRange(T *first, T *last, int bits, std::vector<T> *scratch) {
+  const size_t kCount = last - first;
+  if (bits <= 0 || kCount < 2) return;
+  if (scratch->size() < kCount) scratch->resize(kCount);
+
+  T *from = first, *to = scratch->data();
+  for (int shift = 0; shift < bits; shift += 8) {
+    size_t offsets[256] = {0};
+    for (size_t i = 0; i < kCount; ++i)
+      ++offsets[(from[i].key >> shift) & 0xFF];
+    size_t offset = 0;
+    for (size_t digit = 0; digit < 256; ++digit) {
+      const size_t kDigitCount = offsets[digit];
+      offsets[digit] = offset;
+      offset += kDigitCount;
+    }
+    for (size_t i = 0; i < kCount; ++i)
+      to[offsets[(from[i].key >> shift) & 0xFF]++] = from[i];
+    std::swap(from, to);
+  }
+  if (from != first) std::copy(from, from + kCount, first);
+}
+
+/**
+ * @brief RadixSort Stable parallel radix sort by the lowest bits of the
+ * uint32_t member key of T. A first pass moves the entries into buckets by
+ * the highest byte of those bits, every chunk to positions of its own, and
+ * the buckets, small enough to fit in cache, are then sorted in parallel by
+ * RadixSortRange. Only the first pass goes through memory.
+ * @param bits The bits of the key to sort by, a multiple of 8.
+ * @param entries The entries.
+ */
+template <typename T>
+void RadixSort(int bits, std::vector<T> *entries) {
+  const size_t kEntries = entries->size();
+  if (bits <= 8 || kEntries <= kRadixSortGrain) {
+    std::vector<T> scratch;
+    RadixSortRange(entries->data(), entries->data() + kEntries, bits,
+                   &scratch);
+    return;
+  }
+
+  const int kShift = bits - 8;
+  const size_t kChunks = NumChunks(kEntries, kRadixSortGrain);
+  std::vector<std::vector<size_t>> offsets(kChunks, std::vector<size_t>(256));
+  ParallelForChunks(kEntries, kChunks,
+                    [&](size_t c, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      ++offsets[c][((*entries)[i].key >> kShift) & 0xFF];
+  });
+
+  std::vector<size_t> buckets(257);
+  size_t offset = 0;
+  for (size_t digit = 0; digit < 256; ++digit) {
+    buckets[digit] = offset;
+    for (size_t c = 0; c < kChunks; ++c) {
+      const size_t kCount = offsets[c][digit];
+      offsets[c][digit] = offset;
+      offset += kCount;
+    }
+  }
+  buckets[256] = offset;
+
+  std::vector<T> sorted(kEntries);
+  ParallelForChunks(kEntries, kChunks,
+                    [&](size_t c, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      sorted[offsets[c][((*entries)[i].key >> kShift) & 0xFF]++] =
+          (*entries)[i];
+  });
+
+  ParallelFor(256, 1, [&](size_t begin, size_t end) {
+    std::vector<T> scratch;
+    for (size_t digit = begin; digit < end; ++digit)
+      RadixSortRange(sorted.data() + buckets[digit],
+                     sorted.data() + buckets[digit + 1], kShift, &scratch);
+  });
+  entries->swap(sorted);
+}
+
+}  // namespace data_representation
+
+#endif  // RADIX_SORT_H_
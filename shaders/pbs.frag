@@ -7,6 +7,7 @@ out vec4 frag_color;
 in vec3 frag_normal;
 in vec3 frag_position;
 in vec2 texCoords;
+in float frag_occlusion;
 
 uniform vec3 light;
 uniform vec3 fresnel;
@@ -119,6 +120,7 @@ void main (void) {
 
     vec3 result = vec3(diffuse * kd + specular * ks);
     result *= dln;
+    result *= frag_occlusion;
 
     float gamma = 2.2;
     result = pow(result, vec3(1.0/gamma));
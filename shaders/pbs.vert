@@ -3,20 +3,41 @@
 layout (location = 0) in vec3 vert;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoord;
+// Baked ambient occlusion, 1 for meshes without it.
+layout (location = 3) in float occlusion;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 uniform mat3 normal_matrix;
 
+// Decoding of the vertex format, see PackedVertices.
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+uniform bool octahedral_normals;
+
+vec3 DecodeNormal(vec3 encoded) {
+    if (!octahedral_normals) return encoded;
+    vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 out vec3 frag_normal;
 out vec3 frag_position;
 out vec2 texCoords;
+out float frag_occlusion;
 
 void main(void)  {
-    frag_normal = normalize(normal_matrix * normal);
-    frag_normal = normal;
-    frag_position = vec3(model * vec4(vert, 1.0));
-    gl_Position = projection * view * model * vec4(vert, 1.0);
+    vec3 position = position_offset + position_scale * vert;
+    vec3 decoded_normal = DecodeNormal(normal);
+
+    frag_normal = normalize(normal_matrix * decoded_normal);
+    frag_normal = decoded_normal;
+    frag_position = vec3(model * vec4(position, 1.0));
+    gl_Position = projection * view * model * vec4(position, 1.0);
     texCoords = texCoord;
+    frag_occlusion = occlusion;
 }
@@ -0,0 +1,133 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef TEXT_PARSING_H_
+#define TEXT_PARSING_H_
+
+#include <cmath>
+#include <cstdint>
+
+namespace data_representation {
+
+/**
+ * @brief SkipSpaces Advances p over blanks, without crossing line breaks.
+ */
+inline const char *SkipSpaces(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+  return p;
+}
+
+/**
+ * @brief SkipWhitespace Advances p over blanks and line breaks.
+ */
+inline const char *SkipWhitespace(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+    ++p;
+  return p;
+}
+
+/**
+ * @brief SkipLine Advances p past the next line break.
+ */
+inline const char *SkipLine(const char *p, const char *end) {
+  while (p < end && *p != '\n') ++p;
+  return p < end ? p + 1 : end;
+}
+
+/**
+ * @brief ParseDouble Parses a decimal number in [sign]digits[.digits][e[sign]
+ * digits] format starting at *p, without needing a null terminated buffer.
+ * @param p Cursor, advanced past the number on success.
+ * @param end End of the buffer.
+ * @param value The parsed value.
+ * @return Whether a number was found at *p.
+ */
+inline bool ParseDouble(const char **p, const char *end, double *value) {
+  static const double kPowers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                   1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                   1e18, 1e19, 1e20, 1e21, 1e22};
+
+  const char *c = *p;
+  bool negative = false;
+  if (c < end && (*c == '-' || *c == '+')) negative = *c++ == '-';
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  for (; c < end && *c >= '0' && *c <= '9'; ++c, ++digits) {
+    if (mantissa < 1000000000000000000ull)
+      mantissa = mantissa * 10 + static_cast<uint64_t>(*c - '0');
+    else
+      ++exponent;
+  }
+  if (c < end && *c == '.') {
+    for (++c; c < end && *c >= '0' && *c <= '9'; ++c, ++digits) {
+      if (mantissa < 1000000000000000000ull) {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*c - '0');
+        --exponent;
+      }
+    }
+  }
+  if (digits == 0) return false;
+
+  if (c < end && (*c == 'e' || *c == 'E')) {
+    const char *e = c + 1;
+    bool negative_exponent = false;
+    if (e < end && (*e == '-' || *e == '+')) negative_exponent = *e++ == '-';
+    if (e < end && *e >= '0' && *e <= '9') {
+      int explicit_exponent = 0;
+      for (; e < end && *e >= '0' && *e <= '9'; ++e)
+        if (explicit_exponent < 10000)
+          explicit_exponent = explicit_exponent * 10 + (*e - '0');
+      exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+      c = e;
+    }
+  }
+
+  double result = static_cast<double>(mantissa);
+  if (exponent < 0 && exponent >= -22)
+    result /= kPowers[-exponent];
+  else if (exponent > 0 && exponent <= 22)
+    result *= kPowers[exponent];
+  else if (exponent != 0)
+    result *= std::pow(10.0, exponent);
+
+  *value = negative ? -result : result;
+  *p = c;
+  return true;
+}
+
+/**
+ * @brief ParseFloat Single precision version of ParseDouble.
+ */
+inline bool ParseFloat(const char **p, const char *end, float *value) {
+  double result;
+  if (!ParseDouble(p, end, &result)) return false;
+  *value = static_cast<float>(result);
+  return true;
+}
+
+/**
+ * @brief ParseInt Parses a decimal integer in [sign]digits format.
+ * @param p Cursor, advanced past the number on success.
+ * @param end End of the buffer.
+ * @param value The parsed value.
+ * @return Whether an integer was found at *p.
+ */
+inline bool ParseInt(const char **p, const char *end, int64_t *value) {
+  const char *c = *p;
+  bool negative = false;
+  if (c < end && (*c == '-' || *c == '+')) negative = *c++ == '-';
+  if (c == end || *c < '0' || *c > '9') return false;
+
+  int64_t result = 0;
+  for (; c < end && *c >= '0' && *c <= '9'; ++c) result = result * 10 + (*c - '0');
+
+  *value = negative ? -result : result;
+  *p = c;
+  return true;
+}
+
+}  // namespace data_representation
+
+#endif  // TEXT_PARSING_H_
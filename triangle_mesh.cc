@@ -4,9 +4,11 @@
 
 #include <algorithm>
 #include <limits>
+#include <utility>
 
 #include <iostream>
-#include <glm/geometric.hpp>
+
+#include "./vertex_normals.h"
 
 namespace data_representation {
 
@@ -17,6 +19,16 @@ void TriangleMesh::Clear() {
   faces_.clear();
   normals_.clear();
   texCoords_.clear();
+  submeshes_.clear();
+  materials_.clear();
+  lods_.clear();
+  meshlets_.clear();
+  streams_.clear();
+  diffuseMap_.clear();
+  InvalidateAdjacency();
+  released_ = false;
+  released_vertices_ = 0;
+  released_faces_ = 0;
 
   min_ = glm::vec3(std::numeric_limits<float>::max(),
                          std::numeric_limits<float>::max(),
@@ -28,40 +40,77 @@ void TriangleMesh::Clear() {
 
 void TriangleMesh::computeNormals()
 {
-    normals_.clear();
-    std::vector<std::vector<int> > facesPerVertex(vertices_.size()/3);
-
-    //compute normals per face and facesPerVertex structure
-    std::vector<float> fNormals(faces_.size());
-    for(auto i = 0; i < faces_.size(); i+=3) {
-        glm::vec3 v1(vertices_[3*faces_[i]],      vertices_[3*faces_[i]+1],   vertices_[3*faces_[i]+2]);
-        glm::vec3 v2(vertices_[3*faces_[i+1]],    vertices_[3*faces_[i+1]+1], vertices_[3*faces_[i+1]+2]);
-        glm::vec3 v3(vertices_[3*faces_[i+2]],    vertices_[3*faces_[i+2]+1], vertices_[3*faces_[i+2]+2]);
-
-        glm::vec3 v12 = v2-v1;
-        glm::vec3 v13 = v3-v1;
-        glm::normalize(v12);
-        glm::normalize(v13);
-
-        glm::vec3 n = glm::cross(v12,v13);
-        fNormals[i] = n.x;    fNormals[i+1] = n.y;  fNormals[i+2] = n.z;
-
-        facesPerVertex[faces_[i]].push_back(i/3);
-        facesPerVertex[faces_[i+1]].push_back(i/3);
-        facesPerVertex[faces_[i+2]].push_back(i/3);
-    }
-
-    //compute normals per vertex
-    normals_.reserve(vertices_.size());
-    for(auto i = 0; i < vertices_.size(); ++i) {
-        glm::vec3 n;
-        for(auto j = 0; j < facesPerVertex[i/3].size(); ++j) {
-            n += glm::vec3(fNormals[j*3], fNormals[j*3+1], fNormals[j*3+2]);
-        }
-        glm::normalize(n);
-        normals_[i] = n.x;    normals_[i+1] = n.y;  normals_[i+2] = n.z;
-    }
+    ComputeVertexNormals(vertices_, faces_, VertexCorners(), &normals_);
     std::cout << "Normals computed!" << std::endl;
 }
 
+const CsrAdjacency &TriangleMesh::VertexCorners() {
+  if (vertex_corners_.empty())
+    BuildVertexCorners(faces_, vertices_.size() / 3, &vertex_corners_);
+  return vertex_corners_;
+}
+
+const CsrAdjacency &TriangleMesh::VertexNeighbors() {
+  if (vertex_neighbors_.empty())
+    BuildVertexNeighbors(faces_, VertexCorners(), &vertex_neighbors_);
+  return vertex_neighbors_;
+}
+
+void TriangleMesh::InvalidateAdjacency() {
+  vertex_corners_ = CsrAdjacency();
+  vertex_neighbors_ = CsrAdjacency();
+}
+
+const VertexStream *TriangleMesh::FindStream(const std::string &name) const {
+  for (const auto &stream : streams_)
+    if (stream.name == name) return &stream;
+  return nullptr;
+}
+
+VertexStream *TriangleMesh::SetStream(VertexStream stream) {
+  for (auto &existing : streams_) {
+    if (existing.name != stream.name) continue;
+    existing = std::move(stream);
+    return &existing;
+  }
+  streams_.push_back(std::move(stream));
+  return &streams_.back();
+}
+
+uint64_t TriangleMesh::ResidentBytes() const {
+  uint64_t bytes =
+      sizeof(float) *
+          (vertices_.size() + normals_.size() + texCoords_.size()) +
+      sizeof(int) * faces_.size() + sizeof(Meshlet) * meshlets_.size() +
+      sizeof(uint32_t) *
+          (vertex_corners_.offsets.size() + vertex_corners_.indices.size() +
+           vertex_neighbors_.offsets.size() + vertex_neighbors_.indices.size());
+  for (const auto &lod : lods_) bytes += sizeof(int) * lod.faces.size();
+  return bytes + VertexStreamBytes(streams_);
+}
+
+void TriangleMesh::ReleaseArrays() {
+  if (released_) return;
+  released_vertices_ = VertexCount();
+  released_faces_ = FaceCount();
+  released_ = true;
+
+  // Swapping with empty vectors frees the memory, unlike clear.
+  std::vector<float>().swap(vertices_);
+  std::vector<int>().swap(faces_);
+  std::vector<float>().swap(normals_);
+  std::vector<float>().swap(texCoords_);
+  std::vector<MeshLod>().swap(lods_);
+  std::vector<VertexStream>().swap(streams_);
+  InvalidateAdjacency();
+}
+
+size_t TriangleMesh::VertexCount() const {
+  return released_ ? released_vertices_ : vertices_.size() / 3;
+}
+
+size_t TriangleMesh::FaceCount() const {
+  return released_ ? released_faces_ : faces_.size() / 3;
+}
+
 }  // namespace data_representation
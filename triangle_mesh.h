@@ -5,11 +5,116 @@
 
 #include <glm/vec3.hpp>
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 
+#include "./mesh_adjacency.h"
+#include "./vertex_stream.h"
+
 namespace data_representation {
 
+/**
+ * @brief The Material struct Surface properties shared by a range of faces.
+ */
+struct Material {
+  std::string name;
+
+  /**
+   * @brief diffuse_map Path to the diffuse texture, empty if there is none.
+   */
+  std::string diffuse_map;
+};
+
+/**
+ * @brief The Submesh struct Contiguous range of faces_ drawn with the same
+ * material.
+ */
+struct Submesh {
+  /**
+   * @brief first Offset of the first index of the range in faces_.
+   */
+  unsigned int first;
+
+  /**
+   * @brief count Number of indices of the range.
+   */
+  unsigned int count;
+
+  /**
+   * @brief material Index into TriangleMesh::materials_, -1 if none.
+   */
+  int material;
+
+  /**
+   * @brief min The minimum point of the bounding box of the range.
+   */
+  glm::vec3 min;
+
+  /**
+   * @brief max The maximum point of the bounding box of the range.
+   */
+  glm::vec3 max;
+};
+
+/**
+ * @brief The MeshLod struct Coarser version of a mesh that indexes the same
+ * vertices.
+ */
+struct MeshLod {
+  /**
+   * @brief faces Three vertex indices per triangle.
+   */
+  std::vector<int> faces;
+
+  /**
+   * @brief submeshes Ranges of faces, one per submesh of the full mesh. Empty
+   * if the mesh has none.
+   */
+  std::vector<Submesh> submeshes;
+
+  /**
+   * @brief error Geometric error of the level, relative to the longest edge
+   * of the bounding box of the mesh.
+   */
+  float error;
+};
+
+/**
+ * @brief The Meshlet struct Small contiguous range of faces_ with the bounds
+ * used to cull it, see BuildMeshlets.
+ */
+struct Meshlet {
+  /**
+   * @brief first Offset of the first index of the range in faces_.
+   */
+  unsigned int first;
+
+  /**
+   * @brief count Number of indices of the range.
+   */
+  unsigned int count;
+
+  /**
+   * @brief center The center of the bounding sphere of the range.
+   */
+  glm::vec3 center;
+  float radius;
+
+  /**
+   * @brief cone_axis Average direction of the normals of the triangles.
+   */
+  glm::vec3 cone_axis;
+
+  /**
+   * @brief cone_cutoff Sine of the largest angle between cone_axis and the
+   * normals of the triangles. 1 or more if they are not all within 90
+   * degrees of the axis, in which case the range is never backfacing.
+   */
+  float cone_cutoff;
+};
+
 class TriangleMesh {
  public:
   /**
@@ -22,6 +127,12 @@ class TriangleMesh {
    */
   ~TriangleMesh() {}
 
+  // The destructor would otherwise turn moves into copies of the arrays.
+  TriangleMesh(const TriangleMesh &) = default;
+  TriangleMesh(TriangleMesh &&) = default;
+  TriangleMesh &operator=(const TriangleMesh &) = default;
+  TriangleMesh &operator=(TriangleMesh &&) = default;
+
   /**
    * @brief Clear Empties the data arrays and resets the bounding box vertices.
    */
@@ -32,6 +143,69 @@ class TriangleMesh {
   */
   void computeNormals();
 
+  /**
+   * @brief VertexCorners Vertex-to-face adjacency, see BuildVertexCorners. It
+   * is built on first use and kept until InvalidateAdjacency is called.
+   */
+  const CsrAdjacency &VertexCorners();
+
+  /**
+   * @brief VertexNeighbors Vertex-to-vertex adjacency, see
+   * BuildVertexNeighbors. It is built on first use and kept until
+   * InvalidateAdjacency is called.
+   */
+  const CsrAdjacency &VertexNeighbors();
+
+  /**
+   * @brief InvalidateAdjacency Drops the cached adjacency and frees its
+   * memory. Must be called after modifying faces_ or the number of vertices.
+   */
+  void InvalidateAdjacency();
+
+  /**
+   * @brief FindStream The stream with the given name.
+   * @return The stream or nullptr if the mesh has none with that name.
+   */
+  const VertexStream *FindStream(const std::string &name) const;
+
+  /**
+   * @brief SetStream Adds a stream, replacing the one with the same name, if
+   * any.
+   * @return The stored stream.
+   */
+  VertexStream *SetStream(VertexStream stream);
+
+  /**
+   * @brief ResidentBytes Memory used by the vertex, face, level of detail,
+   * meshlet and stream arrays and the cached adjacency.
+   */
+  uint64_t ResidentBytes() const;
+
+  /**
+   * @brief ReleaseArrays Frees the vertex, face, level of detail and stream
+   * arrays and the adjacency, e.g. once the mesh is on the GPU. The bounding
+   * box, submeshes, materials and meshlets, which drawing needs, are kept, and
+   * so are the counts of vertices and faces. Reloading the mesh is up to the
+   * caller, see ReloadMeshArrays.
+   */
+  void ReleaseArrays();
+
+  /**
+   * @brief released Whether the arrays have been released since the mesh was
+   * last cleared.
+   */
+  bool released() const { return released_; }
+
+  /**
+   * @brief VertexCount The number of vertices, also after ReleaseArrays.
+   */
+  size_t VertexCount() const;
+
+  /**
+   * @brief FaceCount The number of triangles, also after ReleaseArrays.
+   */
+  size_t FaceCount() const;
+
  public:
   std::vector<float> vertices_;
   std::vector<int> faces_;
@@ -39,6 +213,35 @@ class TriangleMesh {
   std::vector<float> texCoords_;
   std::string diffuseMap_;
 
+  /**
+   * @brief submeshes_ Face ranges sorted by material. Empty if the whole mesh
+   * is drawn at once.
+   */
+  std::vector<Submesh> submeshes_;
+
+  /**
+   * @brief materials_ The materials referenced by submeshes_.
+   */
+  std::vector<Material> materials_;
+
+  /**
+   * @brief lods_ Levels of detail from finest to coarsest, not including the
+   * full mesh. Passes that renumber the vertices update them too.
+   */
+  std::vector<MeshLod> lods_;
+
+  /**
+   * @brief meshlets_ Partition of faces_ in order, empty if it has not been
+   * built. Passes that reorder faces_ drop it.
+   */
+  std::vector<Meshlet> meshlets_;
+
+  /**
+   * @brief streams_ Further per-vertex attributes, each with a record for
+   * every vertex and a distinct name.
+   */
+  std::vector<VertexStream> streams_;
+
   /**
    * @brief min The minimum point of the bounding box.
    */
@@ -48,6 +251,14 @@ class TriangleMesh {
    * @brief max The maximum point of the bounding box.
    */
   glm::vec3 max_;
+
+ private:
+  CsrAdjacency vertex_corners_;
+  CsrAdjacency vertex_neighbors_;
+
+  bool released_;
+  size_t released_vertices_;
+  size_t released_faces_;
 };
 
 }  // namespace data_representation
@@ -0,0 +1,205 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <vertex_attributes.h>
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "./parallel.h"
+#include "./vertex_normals.h"
+
+namespace data_representation {
+
+namespace {
+
+const size_t kBlock = 256;
+const size_t kLanes = 8;
+const size_t kMinVerticesPerThread = 1 << 15;
+
+const float kPi = 3.14159274f;
+const float kHalfPi = 1.57079637f;
+
+/**
+ * @brief Atan2 atan2(y, x) through a minimax polynomial on [0, 1] and the
+ * octant symmetries, with an absolute error below 1e-5. The symmetries are
+ * applied by multiplying with the comparison results instead of selecting,
+ * since GCC does not if-convert floating-point arithmetic that may trap, and
+ * the loops using it would not vectorize otherwise.
+ */
+inline float Atan2(float y, float x) {
+  const float kAbsX = std::fabs(x);
+  const float kAbsY = std::fabs(y);
+  const float kMax = std::max(kAbsX, kAbsY);
+  const float kMin = std::min(kAbsX, kAbsY);
+  const float a = kMin / (kMax + static_cast<float>(kMax == 0.f));
+  const float s = a * a;
+  float angle =
+      a * (0.99997726f +
+           s * (-0.33262347f +
+                s * (0.19354346f +
+                     s * (-0.11643287f +
+                          s * (0.05265332f + s * -0.01172120f)))));
+  angle += static_cast<float>(kAbsY > kAbsX) * (kHalfPi - 2.f * angle);
+  angle += static_cast<float>(x < 0.f) * (kPi - 2.f * angle);
+  return std::copysign(angle, y);
+}
+
+/**
+ * @brief Sqrt Square root of a non-negative x through the bit-level estimate
+ * of its inverse refined by three Newton steps, with a relative error below
+ * 1e-6. Unlike std::sqrt it never sets errno, so it needs no branch.
+ */
+inline float Sqrt(float x) {
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5f375a86u - (bits >> 1);
+  float inverse;
+  memcpy(&inverse, &bits, sizeof(inverse));
+  inverse *= 1.5f - 0.5f * x * inverse * inverse;
+  inverse *= 1.5f - 0.5f * x * inverse * inverse;
+  inverse *= 1.5f - 0.5f * x * inverse * inverse;
+  return x * inverse;
+}
+
+/**
+ * @brief Asin asin(x) for x clamped to [-1, 1], through the polynomial of
+ * Abramowitz and Stegun 4.4.46, with an absolute error below 1e-6 after the
+ * float evaluation. Branch-free like Atan2.
+ */
+inline float Asin(float x) {
+  float abs_x = std::fabs(x);
+  abs_x -= static_cast<float>(abs_x > 1.f) * (abs_x - 1.f);
+  float polynomial = -0.0012624911f;
+  polynomial = polynomial * abs_x + 0.0066700901f;
+  polynomial = polynomial * abs_x - 0.0170881256f;
+  polynomial = polynomial * abs_x + 0.0308918810f;
+  polynomial = polynomial * abs_x - 0.0501743046f;
+  polynomial = polynomial * abs_x + 0.0889789874f;
+  polynomial = polynomial * abs_x - 0.2145988016f;
+  polynomial = polynomial * abs_x + 1.5707963050f;
+  return std::copysign(kHalfPi - Sqrt(1.f - abs_x) * polynomial, x);
+}
+
+/**
+ * @brief SweepVertices Updates the bounds with the vertices [begin, end) and
+ * fills their texture coordinates and normalizes their normals if the arrays
+ * are given. The vertices are processed in blocks whose coordinates are
+ * copied into contiguous arrays, so that the loops over them vectorize.
+ */
+void SweepVertices(const float *positions, size_t begin, size_t end,
+                   float *texcoords, float *normals, glm::vec3 *min,
+                   glm::vec3 *max) {
+  float coordinates[3][kBlock];
+  float s[kBlock], t[kBlock];
+
+  // Bounds per lane, as a single running minimum would be a reduction that
+  // only vectorizes with relaxed floating-point semantics.
+  float low[3][kLanes], high[3][kLanes];
+  for (int j = 0; j < 3; ++j) {
+    std::fill(low[j], low[j] + kLanes, (*min)[j]);
+    std::fill(high[j], high[j] + kLanes, (*max)[j]);
+  }
+
+  for (size_t first = begin; first < end; first += kBlock) {
+    const size_t kCount = std::min(kBlock, end - first);
+    const float *kPositions = positions + first * 3;
+
+    for (size_t i = 0; i < kCount; ++i)
+      for (int j = 0; j < 3; ++j) coordinates[j][i] = kPositions[i * 3 + j];
+    // The last block is padded with its first vertex, so that the loops below
+    // always run over whole blocks and vectorize without a remainder.
+    for (int j = 0; j < 3; ++j)
+      std::fill(coordinates[j] + kCount, coordinates[j] + kBlock,
+                coordinates[j][0]);
+
+    for (int j = 0; j < 3; ++j)
+      for (size_t i = 0; i < kBlock; i += kLanes)
+        for (size_t k = 0; k < kLanes; ++k) {
+          low[j][k] = std::min(low[j][k], coordinates[j][i + k]);
+          high[j][k] = std::max(high[j][k], coordinates[j][i + k]);
+        }
+
+    if (texcoords != nullptr) {
+      for (size_t i = 0; i < kBlock; ++i) {
+        // Convert -PI...PI and -PI/2...PI/2 to 0...1.
+        s[i] = Atan2(coordinates[1][i], coordinates[0][i]) * (0.5f / kPi) +
+               0.5f;
+        t[i] = Asin(coordinates[2][i]) * (1.f / kPi) + 0.5f;
+      }
+      float *texcoord = texcoords + first * 2;
+      for (size_t i = 0; i < kCount; ++i) {
+        texcoord[i * 2] = s[i];
+        texcoord[i * 2 + 1] = t[i];
+      }
+    }
+
+    if (normals != nullptr)
+      for (size_t i = 0; i < kCount; ++i) Normalize(normals + (first + i) * 3);
+  }
+
+  for (int j = 0; j < 3; ++j) {
+    (*min)[j] = *std::min_element(low[j], low[j] + kLanes);
+    (*max)[j] = *std::max_element(high[j], high[j] + kLanes);
+  }
+}
+
+}  // namespace
+
+uint32_t MissingVertexAttributes(const TriangleMesh &mesh,
+                                 uint32_t attributes) {
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  if (mesh.normals_.size() == kVertices * 3) attributes &= ~kNormalAttribute;
+  if (mesh.texCoords_.size() == kVertices * 2)
+    attributes &= ~kTexCoordAttribute;
+  return attributes;
+}
+
+void ComputeVertexAttributes(uint32_t attributes, TriangleMesh *mesh,
+                             LoadProfile *profile) {
+  const size_t kVertices = mesh->vertices_.size() / 3;
+  const uint64_t kVertexBytes = sizeof(float) * mesh->vertices_.size();
+  const uint32_t kMissing = MissingVertexAttributes(*mesh, attributes);
+
+  const bool kNormals = (kMissing & kNormalAttribute) != 0;
+  if (kNormals) {
+    ScopedStage stage(profile, "normals",
+                      kVertexBytes + sizeof(int) * mesh->faces_.size());
+    AccumulateVertexNormals(mesh);
+  }
+
+  const bool kTexCoords = (kMissing & kTexCoordAttribute) != 0;
+  if (kTexCoords) mesh->texCoords_.resize(kVertices * 2);
+  float *texcoords = kTexCoords ? mesh->texCoords_.data() : nullptr;
+  float *normals = kNormals ? mesh->normals_.data() : nullptr;
+
+  ScopedStage stage(profile, "vertex attributes",
+                    kVertexBytes * (1 + (kNormals ? 2 : 0)) +
+                        sizeof(float) * (kTexCoords ? kVertices * 2 : 0));
+  const size_t kChunks = NumChunks(kVertices, kMinVerticesPerThread);
+  std::vector<glm::vec3> mins(kChunks,
+                              glm::vec3(std::numeric_limits<float>::max()));
+  std::vector<glm::vec3> maxs(kChunks,
+                              glm::vec3(std::numeric_limits<float>::lowest()));
+  ParallelForChunks(kVertices, kChunks,
+                    [&](size_t c, size_t begin, size_t end) {
+    SweepVertices(mesh->vertices_.data(), begin, end, texcoords, normals,
+                  &mins[c], &maxs[c]);
+  });
+
+  // Vertices dropped since the last sweep, e.g. by CleanMesh, must not
+  // widen the bounds.
+  mesh->min_ = glm::vec3(std::numeric_limits<float>::max());
+  mesh->max_ = glm::vec3(std::numeric_limits<float>::lowest());
+  for (size_t c = 0; c < kChunks; ++c) {
+    mesh->min_ = glm::min(mesh->min_, mins[c]);
+    mesh->max_ = glm::max(mesh->max_, maxs[c]);
+  }
+}
+
+}  // namespace data_representation
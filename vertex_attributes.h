@@ -0,0 +1,56 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef VERTEX_ATTRIBUTES_H_
+#define VERTEX_ATTRIBUTES_H_
+
+#include <load_profile.h>
+#include <triangle_mesh.h>
+
+#include <cstdint>
+
+namespace data_representation {
+
+/**
+ * @brief The VertexAttribute enum Attributes derived from the positions after
+ * a mesh is read, combined as a mask.
+ */
+enum VertexAttribute : uint32_t {
+  /**
+   * @brief kNormalAttribute Angle-weighted vertex normals.
+   */
+  kNormalAttribute = 1 << 0,
+
+  /**
+   * @brief kTexCoordAttribute Spherical texture coordinates, the longitude
+   * atan2(y, x) and latitude asin(z) of the position mapped to [0, 1].
+   */
+  kTexCoordAttribute = 1 << 1,
+
+  kAllVertexAttributes = kNormalAttribute | kTexCoordAttribute
+};
+
+/**
+ * @brief MissingVertexAttributes The attributes of the mask that the mesh does
+ * not have.
+ */
+uint32_t MissingVertexAttributes(const TriangleMesh &mesh,
+                                 uint32_t attributes);
+
+/**
+ * @brief ComputeVertexAttributes Computes the requested attributes that the
+ * mesh does not have yet, together with its bounding box, which is always
+ * recomputed from the current vertices. The normals need a sweep over the
+ * faces; everything else is done in a single parallel sweep over the
+ * vertices: the bounds, the texture coordinates through vectorizable atan2
+ * and asin approximations with an absolute error below 1e-5, and the
+ * normalization of the accumulated normals.
+ * @param attributes A mask of VertexAttribute values.
+ * @param mesh The mesh, with positions and faces.
+ * @param profile If not null, receives the timing of every sweep.
+ */
+void ComputeVertexAttributes(uint32_t attributes, TriangleMesh *mesh,
+                             LoadProfile *profile = nullptr);
+
+}  // namespace data_representation
+
+#endif  // VERTEX_ATTRIBUTES_H_
@@ -0,0 +1,243 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+const size_t kMinGrain = 1 << 14;
+
+size_t PositionBytes(PositionFormat format) {
+  return format == PositionFormat::kFloat ? 3 * sizeof(float)
+                                          : 4 * sizeof(uint16_t);
+}
+
+size_t NormalBytes(NormalFormat format) {
+  return format == NormalFormat::kFloat ? 3 * sizeof(float) : sizeof(uint32_t);
+}
+
+size_t TexCoordBytes(TexCoordFormat format) {
+  return format == TexCoordFormat::kFloat ? 2 * sizeof(float)
+                                          : 2 * sizeof(uint16_t);
+}
+
+PackedAttribute MakeAttribute(const std::string &name, ComponentType type,
+                              uint32_t components, size_t offset) {
+  return {name, type, components, offset, 0.0f, 1.0f};
+}
+
+ComponentType PositionType(PositionFormat format) {
+  return format == PositionFormat::kFloat ? ComponentType::kFloat32
+                                          : ComponentType::kUnorm16;
+}
+
+/**
+ * @brief NormalAttribute The normal read from the given offset.
+ */
+PackedAttribute NormalAttribute(NormalFormat format, size_t offset) {
+  if (format == NormalFormat::kFloat)
+    return MakeAttribute("normal", ComponentType::kFloat32, 3, offset);
+  if (format == NormalFormat::kInt2101010)
+    return MakeAttribute("normal", ComponentType::kSnorm2101010, 4, offset);
+  return MakeAttribute("normal", ComponentType::kSnorm16, 2, offset);
+}
+
+ComponentType TexCoordType(TexCoordFormat format) {
+  return format == TexCoordFormat::kFloat ? ComponentType::kFloat32
+                                          : ComponentType::kFloat16;
+}
+
+/**
+ * @brief Snorm Rounds a value in [-1, 1] to a signed normalized integer with
+ * the given maximum.
+ */
+int Snorm(float value, int max) {
+  const float kScaled = std::min(1.0f, std::max(-1.0f, value)) * max;
+  return static_cast<int>(kScaled + (kScaled >= 0.0f ? 0.5f : -0.5f));
+}
+
+uint32_t PackInt2101010(const float *normal) {
+  uint32_t packed = 0;
+  for (int i = 0; i < 3; ++i)
+    packed |= (static_cast<uint32_t>(Snorm(normal[i], 511)) & 0x3ff)
+              << (10 * i);
+  return packed;
+}
+
+}  // namespace
+
+const PackedAttribute *PackedVertices::FindAttribute(
+    const std::string &name) const {
+  for (const auto &attribute : attributes)
+    if (attribute.name == name) return &attribute;
+  return nullptr;
+}
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t kSign = (bits >> 16) & 0x8000;
+  const uint32_t kAbs = bits & 0x7fffffff;
+
+  // Infinities and NaNs, then finite values that round past 65504.
+  if (kAbs >= 0x7f800000)
+    return static_cast<uint16_t>(kSign | 0x7c00 |
+                                 (kAbs > 0x7f800000 ? 0x200 : 0));
+  if (kAbs >= 0x477ff000) return static_cast<uint16_t>(kSign | 0x7c00);
+
+  // Subnormal halves, in units of 2^-24. Below 2^-25 everything rounds to 0.
+  if (kAbs < 0x38800000) {
+    if (kAbs <= 0x33000000) return static_cast<uint16_t>(kSign);
+    const uint32_t kMantissa = (kAbs & 0x7fffff) | 0x800000;
+    const uint32_t kShift = 126 - (kAbs >> 23);
+    uint32_t half = kMantissa >> kShift;
+    const uint32_t kRemainder = kMantissa & ((1u << kShift) - 1);
+    const uint32_t kHalfway = 1u << (kShift - 1);
+    if (kRemainder > kHalfway || (kRemainder == kHalfway && (half & 1)))
+      ++half;
+    return static_cast<uint16_t>(kSign | half);
+  }
+
+  // Rebiasing the exponent; a carry out of the mantissa is still correct.
+  uint32_t half = (kAbs >> 13) - ((127 - 15) << 10);
+  const uint32_t kRemainder = kAbs & 0x1fff;
+  if (kRemainder > 0x1000 || (kRemainder == 0x1000 && (half & 1))) ++half;
+  return static_cast<uint16_t>(kSign | half);
+}
+
+void EncodeOctahedral(const float *normal, int16_t *encoded) {
+  const float kL1 =
+      std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+  float x = kL1 > 0.0f ? normal[0] / kL1 : 0.0f;
+  float y = kL1 > 0.0f ? normal[1] / kL1 : 0.0f;
+  // The lower hemisphere is folded over the diagonals.
+  if (normal[2] < 0.0f) {
+    const float kX = x;
+    x = (1.0f - std::fabs(y)) * (kX >= 0.0f ? 1.0f : -1.0f);
+    y = (1.0f - std::fabs(kX)) * (y >= 0.0f ? 1.0f : -1.0f);
+  }
+  encoded[0] = static_cast<int16_t>(Snorm(x, 32767));
+  encoded[1] = static_cast<int16_t>(Snorm(y, 32767));
+}
+
+void PackVertices(const TriangleMesh &mesh, const VertexFormat &format,
+                  const std::vector<std::string> &stream_names,
+                  const std::vector<int> &vertex_remap,
+                  PackedVertices *packed) {
+  const size_t kMeshVertices = mesh.vertices_.size() / 3;
+  const size_t kVertices =
+      vertex_remap.empty() ? kMeshVertices : vertex_remap.size();
+  const bool kHasTexCoords = mesh.texCoords_.size() == 2 * kMeshVertices;
+
+  packed->format = format;
+  const size_t kNormalOffset = PositionBytes(format.positions);
+  const size_t kTexCoordOffset = kNormalOffset + NormalBytes(format.normals);
+  packed->stride = kTexCoordOffset + TexCoordBytes(format.tex_coords);
+  packed->attributes.clear();
+  packed->attributes.push_back(
+      MakeAttribute("position", PositionType(format.positions), 3, 0));
+  packed->attributes.push_back(NormalAttribute(format.normals, kNormalOffset));
+  packed->attributes.push_back(MakeAttribute(
+      "tex_coord", TexCoordType(format.tex_coords), 2, kTexCoordOffset));
+
+  // The padding of kUnorm16 positions takes the first stream that fits.
+  size_t padding = format.positions == PositionFormat::kUnorm16
+                       ? sizeof(uint16_t)
+                       : 0;
+  std::vector<const VertexStream *> streams;
+  std::vector<size_t> stream_offsets;
+  for (const auto &name : stream_names) {
+    const VertexStream *kStream = mesh.FindStream(name);
+    if (kStream == nullptr || kStream->stride == 0) continue;
+    if (kStream->vertex_count() != kMeshVertices) {
+      std::cerr << "Vertex stream " << name << " does not match the mesh"
+                << std::endl;
+      continue;
+    }
+    size_t offset = packed->stride;
+    if (kStream->stride <= padding) {
+      offset = 3 * sizeof(uint16_t);
+      padding = 0;
+    } else {
+      packed->stride += (kStream->stride + 3) / 4 * 4;
+    }
+    PackedAttribute attribute = MakeAttribute(
+        kStream->name, kStream->type, kStream->components, offset);
+    attribute.value_offset = kStream->offset;
+    attribute.value_scale = kStream->scale;
+    packed->attributes.push_back(attribute);
+    streams.push_back(kStream);
+    stream_offsets.push_back(offset);
+  }
+  packed->data.assign(kVertices * packed->stride, 0);
+
+  const glm::vec3 kExtent = mesh.max_ - mesh.min_;
+  if (format.positions == PositionFormat::kUnorm16) {
+    packed->position_offset = mesh.min_;
+    packed->position_scale = kExtent;
+  } else {
+    packed->position_offset = glm::vec3(0.0f);
+    packed->position_scale = glm::vec3(1.0f);
+  }
+
+  ParallelFor(kVertices, kMinGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      uint8_t *vertex = packed->data.data() + i * packed->stride;
+      const size_t v = vertex_remap.empty() ? i : vertex_remap[i];
+      const float *kPosition = &mesh.vertices_[3 * v];
+      const float *kNormal = &mesh.normals_[3 * v];
+
+      if (format.positions == PositionFormat::kFloat) {
+        memcpy(vertex, kPosition, 3 * sizeof(float));
+      } else {
+        uint16_t position[4] = {0, 0, 0, 0};
+        for (int j = 0; j < 3; ++j) {
+          const float kT = kExtent[j] > 0.0f
+                               ? (kPosition[j] - mesh.min_[j]) / kExtent[j]
+                               : 0.0f;
+          position[j] = static_cast<uint16_t>(
+              std::min(1.0f, std::max(0.0f, kT)) * 65535.0f + 0.5f);
+        }
+        memcpy(vertex, position, sizeof(position));
+      }
+
+      for (size_t s = 0; s < streams.size(); ++s)
+        memcpy(vertex + stream_offsets[s],
+               &streams[s]->data[v * streams[s]->stride],
+               streams[s]->stride);
+
+      uint8_t *normal = vertex + kNormalOffset;
+      if (format.normals == NormalFormat::kFloat) {
+        memcpy(normal, kNormal, 3 * sizeof(float));
+      } else if (format.normals == NormalFormat::kInt2101010) {
+        const uint32_t kPacked = PackInt2101010(kNormal);
+        memcpy(normal, &kPacked, sizeof(kPacked));
+      } else {
+        int16_t encoded[2];
+        EncodeOctahedral(kNormal, encoded);
+        memcpy(normal, encoded, sizeof(encoded));
+      }
+
+      if (!kHasTexCoords) continue;
+      uint8_t *tex_coord = vertex + kTexCoordOffset;
+      const float *kTexCoord = &mesh.texCoords_[2 * v];
+      if (format.tex_coords == TexCoordFormat::kFloat) {
+        memcpy(tex_coord, kTexCoord, 2 * sizeof(float));
+      } else {
+        const uint16_t kHalves[2] = {FloatToHalf(kTexCoord[0]),
+                                     FloatToHalf(kTexCoord[1])};
+        memcpy(tex_coord, kHalves, sizeof(kHalves));
+      }
+    }
+  });
+}
+
+}  // namespace data_representation
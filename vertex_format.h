@@ -0,0 +1,204 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef VERTEX_FORMAT_H_
+#define VERTEX_FORMAT_H_
+
+#include <triangle_mesh.h>
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "./vertex_stream.h"
+
+namespace data_representation {
+
+/**
+ * @brief The PositionFormat enum Storage of the vertex positions.
+ */
+enum class PositionFormat {
+  /**
+   * @brief kFloat Three 32-bit floats.
+   */
+  kFloat,
+
+  /**
+   * @brief kUnorm16 Four 16-bit unsigned normalized integers, quantized to
+   * the bounding box of the mesh. The fourth one holds the first packed
+   * stream of at most 2 bytes per vertex, e.g. the baked occlusion, if any.
+   */
+  kUnorm16
+};
+
+/**
+ * @brief The NormalFormat enum Storage of the vertex normals.
+ */
+enum class NormalFormat {
+  /**
+   * @brief kFloat Three 32-bit floats.
+   */
+  kFloat,
+
+  /**
+   * @brief kInt2101010 Signed normalized 10-bit components packed in 32 bits,
+   * as read by GL_INT_2_10_10_10_REV.
+   */
+  kInt2101010,
+
+  /**
+   * @brief kOctahedral Octahedral map of the unit sphere to two 16-bit signed
+   * normalized integers, decoded in the vertex shader.
+   */
+  kOctahedral
+};
+
+/**
+ * @brief The TexCoordFormat enum Storage of the texture coordinates.
+ */
+enum class TexCoordFormat {
+  /**
+   * @brief kFloat Two 32-bit floats.
+   */
+  kFloat,
+
+  /**
+   * @brief kHalf Two 16-bit floats.
+   */
+  kHalf
+};
+
+/**
+ * @brief The VertexFormat struct Layout of the interleaved vertex buffer.
+ */
+struct VertexFormat {
+  PositionFormat positions;
+  NormalFormat normals;
+  TexCoordFormat tex_coords;
+};
+
+/**
+ * @brief kFloatVertexFormat Full precision layout, 32 bytes per vertex, plus
+ * the packed streams.
+ */
+const VertexFormat kFloatVertexFormat = {
+    PositionFormat::kFloat, NormalFormat::kFloat, TexCoordFormat::kFloat};
+
+/**
+ * @brief kCompactVertexFormat Quantized layout, 16 bytes per vertex, plus
+ * the packed streams that do not fit in the padding of the positions.
+ */
+const VertexFormat kCompactVertexFormat = {PositionFormat::kUnorm16,
+                                           NormalFormat::kInt2101010,
+                                           TexCoordFormat::kHalf};
+
+/**
+ * @brief The PackedAttribute struct Where and how an attribute is stored in
+ * the vertices of a PackedVertices.
+ */
+struct PackedAttribute {
+  /**
+   * @brief name "position", "normal", "tex_coord" or the name of a
+   * VertexStream.
+   */
+  std::string name;
+
+  ComponentType type;
+
+  /**
+   * @brief components Components read by the vertex shader. The four of
+   * kSnorm2101010 are always read.
+   */
+  uint32_t components;
+
+  /**
+   * @brief offset Offset of the attribute in a vertex, in bytes, a multiple
+   * of 2 or 4 depending on the type.
+   */
+  size_t offset;
+
+  /**
+   * @brief value_offset The decoded value is value_offset + value_scale * the
+   * value read by the vertex shader, see VertexStream. The positions use
+   * position_offset and position_scale instead.
+   */
+  float value_offset;
+  float value_scale;
+};
+
+/**
+ * @brief The PackedVertices struct Interleaved vertex buffer ready to be
+ * uploaded, with what the shaders need to decode it.
+ */
+struct PackedVertices {
+  VertexFormat format;
+
+  /**
+   * @brief data Vertex count times stride bytes.
+   */
+  std::vector<uint8_t> data;
+
+  /**
+   * @brief stride Bytes per vertex, a multiple of 4.
+   */
+  size_t stride;
+
+  /**
+   * @brief attributes The attributes in a vertex: the position at offset 0,
+   * the normal and the texture coordinates, then the packed streams in
+   * order.
+   */
+  std::vector<PackedAttribute> attributes;
+
+  /**
+   * @brief position_offset The decoded position is position_offset +
+   * position_scale * the position read by the vertex shader.
+   */
+  glm::vec3 position_offset;
+  glm::vec3 position_scale;
+
+  size_t vertex_count() const { return stride == 0 ? 0 : data.size() / stride; }
+
+  /**
+   * @brief FindAttribute The attribute with the given name, or nullptr.
+   */
+  const PackedAttribute *FindAttribute(const std::string &name) const;
+};
+
+/**
+ * @brief PackVertices Builds the interleaved vertex buffer of a mesh in
+ * parallel. Meshes without texture coordinates get zeros. The records of the
+ * requested vertex streams are copied as they are, each one aligned to 4
+ * bytes, except for the first one that fits in the padding of kUnorm16
+ * positions.
+ * @param mesh The mesh, with normals and bounding box.
+ * @param format The layout to use.
+ * @param stream_names The streams to pack, in order, e.g. those the shaders
+ * read. Those the mesh lacks are left out, and the other streams stay on the
+ * CPU.
+ * @param vertex_remap The mesh vertex of every packed vertex, see
+ * PackedIndices. If empty, the mesh vertices are packed in order.
+ * @param packed The resulting buffer.
+ */
+void PackVertices(const TriangleMesh &mesh, const VertexFormat &format,
+                  const std::vector<std::string> &stream_names,
+                  const std::vector<int> &vertex_remap,
+                  PackedVertices *packed);
+
+/**
+ * @brief FloatToHalf Converts to the nearest 16-bit float, rounding to even.
+ * Values out of range become infinities.
+ */
+uint16_t FloatToHalf(float value);
+
+/**
+ * @brief EncodeOctahedral Maps a unit vector to the two signed normalized
+ * coordinates of its octahedral projection.
+ */
+void EncodeOctahedral(const float *normal, int16_t *encoded);
+
+}  // namespace data_representation
+
+#endif  // VERTEX_FORMAT_H_
@@ -0,0 +1,65 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef VERTEX_NORMALS_H_
+#define VERTEX_NORMALS_H_
+
+#include <mesh_adjacency.h>
+#include <triangle_mesh.h>
+
+#include <cmath>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief Normalize Scales a normal to unit length in place. Zero normals are
+ * left as they are.
+ */
+inline void Normalize(float *normal) {
+  const float kLength = std::sqrt(normal[0] * normal[0] +
+                                  normal[1] * normal[1] +
+                                  normal[2] * normal[2]);
+  const float kInverse = kLength > 0.f ? 1.f / kLength : 0.f;
+  for (int i = 0; i < 3; ++i) normal[i] *= kInverse;
+}
+
+/**
+ * @brief ComputeVertexNormals Computes unit per-vertex normals as the sum of
+ * the normals of the adjacent faces weighted by the angle of the face at the
+ * vertex. With few threads the face contributions are scattered in blocks laid
+ * out for vectorization; otherwise they are gathered per vertex in parallel
+ * through a vertex-to-corner CSR, so threads never write to the same vertex.
+ * Both paths add the contributions in face order.
+ * @param vertices Three coordinates per vertex.
+ * @param faces Three vertex indices per triangle.
+ * @param normals Three coordinates per vertex. Vertices without non-degenerate
+ * faces get a zero normal.
+ */
+void ComputeVertexNormals(const std::vector<float> &vertices,
+                          const std::vector<int> &faces,
+                          std::vector<float> *normals);
+
+/**
+ * @brief ComputeVertexNormals Same as above, gathering in parallel through an
+ * already built vertex-to-corner adjacency.
+ * @param vertex_corners The adjacency returned by BuildVertexCorners.
+ */
+void ComputeVertexNormals(const std::vector<float> &vertices,
+                          const std::vector<int> &faces,
+                          const CsrAdjacency &vertex_corners,
+                          std::vector<float> *normals);
+
+/**
+ * @brief AccumulateVertexNormals Computes the normals_ of a mesh as the
+ * angle-weighted sum of the normals of the adjacent faces, see
+ * ComputeVertexNormals. The parallel path gathers through the adjacency
+ * cached on the mesh, see TriangleMesh::VertexCorners. The normals may be
+ * left unnormalized, for callers that normalize them in a later pass over the
+ * vertices anyway.
+ * @param mesh The mesh, with vertices and faces.
+ */
+void AccumulateVertexNormals(TriangleMesh *mesh);
+
+}  // namespace data_representation
+
+#endif  // VERTEX_NORMALS_H_
@@ -0,0 +1,103 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#include <vertex_stream.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+const size_t kMinGrain = 1 << 15;
+
+}  // namespace
+
+size_t ComponentBytes(ComponentType type, size_t count) {
+  switch (type) {
+    case ComponentType::kFloat32:
+      return 4 * count;
+    case ComponentType::kFloat16:
+    case ComponentType::kUnorm16:
+    case ComponentType::kSnorm16:
+      return 2 * count;
+    case ComponentType::kUnorm8:
+    case ComponentType::kSnorm8:
+      return count;
+    case ComponentType::kSnorm2101010:
+      return 4;
+  }
+  return 0;
+}
+
+bool IsNormalized(ComponentType type) {
+  return type != ComponentType::kFloat32 && type != ComponentType::kFloat16;
+}
+
+VertexStream MakeVertexStream(const std::string &name, ComponentType type,
+                              uint32_t components, size_t vertices) {
+  VertexStream stream;
+  stream.name = name;
+  stream.type = type;
+  stream.components = components;
+  stream.stride = static_cast<uint32_t>(ComponentBytes(type, components));
+  stream.offset = 0.0f;
+  stream.scale = 1.0f;
+  stream.data.assign(vertices * stream.stride, 0);
+  return stream;
+}
+
+void DropMismatchedStreams(size_t vertices,
+                           std::vector<VertexStream> *streams) {
+  streams->erase(
+      std::remove_if(streams->begin(), streams->end(),
+                     [&](const VertexStream &stream) {
+                       if (stream.vertex_count() == vertices) return false;
+                       std::cerr << "Dropping the vertex stream " << stream.name
+                                 << ", which has " << stream.vertex_count()
+                                 << " records for " << vertices
+                                 << " vertices" << std::endl;
+                       return true;
+                     }),
+      streams->end());
+}
+
+void PermuteVertexStreams(const std::vector<int> &remap, size_t vertices,
+                          std::vector<VertexStream> *streams) {
+  // A stream out of step with the vertices cannot be moved along, and
+  // keeping it would pair its records with the wrong vertices.
+  DropMismatchedStreams(remap.size(), streams);
+
+  for (auto &stream : *streams) {
+    const size_t kStride = stream.stride;
+    std::vector<uint8_t> permuted(vertices * kStride);
+    ParallelFor(remap.size(), kMinGrain, [&](size_t begin, size_t end) {
+      for (size_t v = begin; v < end; ++v)
+        if (remap[v] >= 0)
+          memcpy(&permuted[remap[v] * kStride], &stream.data[v * kStride],
+                 kStride);
+    });
+    stream.data.swap(permuted);
+  }
+}
+
+bool SameStreamValues(const std::vector<VertexStream> &streams, size_t a,
+                      size_t b) {
+  for (const auto &stream : streams) {
+    if (memcmp(&stream.data[a * stream.stride],
+               &stream.data[b * stream.stride], stream.stride) != 0)
+      return false;
+  }
+  return true;
+}
+
+uint64_t VertexStreamBytes(const std::vector<VertexStream> &streams) {
+  uint64_t bytes = 0;
+  for (const auto &stream : streams) bytes += stream.data.size();
+  return bytes;
+}
+
+}  // namespace data_representation
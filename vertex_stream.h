@@ -0,0 +1,137 @@
+// Author: Imanol Munoz-Pandiella 2023 based on Marc Comino 2020
+
+#ifndef VERTEX_STREAM_H_
+#define VERTEX_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief The ComponentType enum Storage of the components of a vertex
+ * attribute. The values are stored in caches, so they must not change.
+ */
+enum class ComponentType : uint32_t {
+  kFloat32 = 0,
+  kFloat16 = 1,
+
+  /**
+   * @brief kUnorm8 Unsigned normalized 8-bit integers, read as [0, 1].
+   */
+  kUnorm8 = 2,
+
+  /**
+   * @brief kSnorm8 Signed normalized 8-bit integers, read as [-1, 1].
+   */
+  kSnorm8 = 3,
+  kUnorm16 = 4,
+  kSnorm16 = 5,
+
+  /**
+   * @brief kSnorm2101010 Four signed normalized components of 10, 10, 10 and
+   * 2 bits packed in 32 bits, as read by GL_INT_2_10_10_10_REV.
+   */
+  kSnorm2101010 = 6
+};
+
+/**
+ * @brief ComponentBytes Bytes taken by count components of the given type.
+ */
+size_t ComponentBytes(ComponentType type, size_t count);
+
+/**
+ * @brief IsNormalized Whether the components are integers read as [0, 1] or
+ * [-1, 1].
+ */
+bool IsNormalized(ComponentType type);
+
+/**
+ * @brief The VertexStream struct A named per-vertex attribute beyond the
+ * positions, normals and texture coordinates of a TriangleMesh, stored as
+ * typed, tightly packed records, e.g. the baked occlusion or PLY colors. Every
+ * pass that reorders or removes vertices moves the streams along, caches
+ * store them as they are, and PackVertices appends those the shaders read to
+ * the vertex buffer, so a new kind of per-vertex data only has to be written
+ * by its producer.
+ */
+struct VertexStream {
+  /**
+   * @brief name Identifies the attribute, e.g. "color".
+   */
+  std::string name;
+
+  ComponentType type;
+
+  /**
+   * @brief components Components per vertex, from 1 to 4.
+   */
+  uint32_t components;
+
+  /**
+   * @brief stride Bytes per vertex in data.
+   */
+  uint32_t stride;
+
+  /**
+   * @brief offset The value of a normalized component is offset + scale *
+   * the stored value, which lets data outside [0, 1] or [-1, 1] be
+   * quantized. 0 and 1 for data stored as it is.
+   */
+  float offset;
+  float scale;
+
+  /**
+   * @brief data The records of the vertices in order.
+   */
+  std::vector<uint8_t> data;
+
+  size_t vertex_count() const { return stride == 0 ? 0 : data.size() / stride; }
+};
+
+/**
+ * @brief MakeVertexStream A stream of zeroed, tightly packed records for the
+ * given number of vertices, with an offset of 0 and a scale of 1.
+ */
+VertexStream MakeVertexStream(const std::string &name, ComponentType type,
+                              uint32_t components, size_t vertices);
+
+/**
+ * @brief DropMismatchedStreams Removes and reports the streams without a
+ * record per vertex. They are a bug of their producer, and the passes that
+ * index the streams by vertex would read past their end.
+ * @param vertices The number of vertices.
+ * @param streams The streams.
+ */
+void DropMismatchedStreams(size_t vertices,
+                           std::vector<VertexStream> *streams);
+
+/**
+ * @brief PermuteVertexStreams Moves the record of every vertex v of the
+ * streams to remap[v], dropping those with a negative one. Streams without a
+ * record per entry of remap are removed first, see DropMismatchedStreams.
+ * @param remap The new index of every vertex.
+ * @param vertices The number of vertices after the move.
+ * @param streams The streams, with one record per entry of remap.
+ */
+void PermuteVertexStreams(const std::vector<int> &remap, size_t vertices,
+                          std::vector<VertexStream> *streams);
+
+/**
+ * @brief SameStreamValues Whether two vertices have the same records in all
+ * the streams, which must have a record per vertex, see
+ * DropMismatchedStreams.
+ */
+bool SameStreamValues(const std::vector<VertexStream> &streams, size_t a,
+                      size_t b);
+
+/**
+ * @brief VertexStreamBytes Bytes taken by the records of the streams.
+ */
+uint64_t VertexStreamBytes(const std::vector<VertexStream> &streams);
+
+}  // namespace data_representation
+
+#endif  // VERTEX_STREAM_H_